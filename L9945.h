@@ -2,12 +2,39 @@
 #ifndef NOWTECH_L9945_H
 #define NOWTECH_L9945_H
 
+#include <array>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <optional>
+#include <utility>
 #include <algorithm>
+#include <type_traits>
 #include "BanCopyMove.h"
 
+// Compile-time configuration, can be overridden by defining these before including this file.
+
+// Maximum number of watches registered in an L9945 instance.
+#ifndef NOWTECH_L9945_WATCH_COUNT
+#define NOWTECH_L9945_WATCH_COUNT 4u
+#endif
+
+// Define NOWTECH_L9945_INSTRUMENTATION to collect SPI transfer statistics and operation latencies.
+
+// Define NOWTECH_L9945_TRACE_LENGTH as a power of 2 to record the last that many SPI frames.
+#ifndef NOWTECH_L9945_TRACE_LENGTH
+#define NOWTECH_L9945_TRACE_LENGTH 0u
+#endif
+
+// RAM footprint options, see L9945::getFootprint() for the result.
+// Define NOWTECH_L9945_SINGLE_CACHE to keep the configuration of commands 1-8 in the read cache instead of a separate
+// write cache. The read-backs of these commands then only update the verification status, and get* return the
+// configuration to write.
+// Define NOWTECH_L9945_SHARED_FRAME_BUFFER to use one SPI frame buffer for all L9945 instances.
+// Transfers to different chips must not run concurrently then.
+// Define NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT to omit the embedded DiagnosticsResult. diagnose() then needs one
+// given by the caller.
+
 namespace nowtech {
 
 namespace l9945 {
@@ -30,12 +57,89 @@ constexpr uint32_t calculateParity(uint32_t const aIn) noexcept {
   return ~result & 1u;
 }
 
+constexpr uint32_t getBitWidth(uint32_t const aValue) noexcept {
+  uint32_t result = 0u;
+  for (uint32_t work = aValue; work > 0u; work >>= 1u) {
+    ++result;
+  }
+  return result;
+}
+
+constexpr uint32_t countOnes(uint32_t const aValue) noexcept {
+  uint32_t result = 0u;
+  for (uint32_t work = aValue; work > 0u; work &= work - 1u) {
+    ++result;
+  }
+  return result;
+}
+
+constexpr uint32_t bytes2word(uint8_t const * const aBytes) noexcept {
+  return (static_cast<uint32_t>(aBytes[0]) << 24u) |
+    (static_cast<uint32_t>(aBytes[1]) << 16u) |
+    (static_cast<uint32_t>(aBytes[2]) << 8u) |
+    aBytes[3];
+}
+
+/// SPI bus timing used to predict how long driver operations occupy the bus.
+struct BusCostModel final {
+  uint32_t mSpiClockHz      = 4000000u;
+  uint32_t mCsSetupNs       = 0u;   // from CS assertion to the first clock edge
+  uint32_t mCsHoldNs        = 0u;   // from the last clock edge to CS deassertion
+  uint32_t mInterFrameGapNs = 0u;   // minimum CS high time between frames, including software overhead
+
+  constexpr uint32_t getFrameNanos() const noexcept {
+    return static_cast<uint32_t>((32ull * 1000000000ull + mSpiClockHz - 1u) / mSpiClockHz) + mCsSetupNs + mCsHoldNs + mInterFrameGapNs;
+  }
+};
+
+/// Bus occupation of an operation: SPI frames and the blocking delays between them.
+struct BusCost final {
+  uint32_t mFrames  = 0u;
+  uint32_t mDelayMs = 0u;
+
+  constexpr uint64_t getNanos(BusCostModel const &aModel) const noexcept {
+    return static_cast<uint64_t>(mFrames) * aModel.getFrameNanos() + mDelayMs * 1000000ull;
+  }
+
+  constexpr uint32_t getMicros(BusCostModel const &aModel) const noexcept {
+    return static_cast<uint32_t>((getNanos(aModel) + 999u) / 1000u);
+  }
+
+  constexpr BusCost operator+(BusCost const &aOther) const noexcept {
+    return BusCost{ mFrames + aOther.mFrames, mDelayMs + aOther.mDelayMs };
+  }
+};
+
+template<typename tInterface, typename = void>
+struct HasGetMicros : std::false_type {};
+
+template<typename tInterface>
+struct HasGetMicros<tInterface, std::void_t<decltype(std::declval<tInterface&>().getMicros())>> : std::true_type {};
+
+template<typename tInterface, typename = void>
+struct HasSetPwmQ15 : std::false_type {};
+
+template<typename tInterface>
+struct HasSetPwmQ15<tInterface, std::void_t<decltype(std::declval<tInterface&>().setPwmQ15(int32_t(), 0u))>> : std::true_type {};
+
+template<typename tInterface, typename tValue, typename = void>
+struct HasSetPwmAll : std::false_type {};
+
+template<typename tInterface, typename tValue>
+struct HasSetPwmAll<tInterface, tValue, std::void_t<decltype(std::declval<tInterface&>().setPwmAll(std::declval<tValue const*>(), 0u))>> : std::true_type {};
+
+template<typename tInterface, typename tValue, typename = void>
+struct HasSetPwmBridges : std::false_type {};
+
+template<typename tInterface, typename tValue>
+struct HasSetPwmBridges<tInterface, tValue, std::void_t<decltype(std::declval<tInterface&>().setPwmBridges(std::declval<tValue>(), std::declval<tValue>(), 0u))>> : std::true_type {};
+
 }
 
 /*
 /// Example class providing an interface from the L9945 class to the actual application.
-/// The L9945 instance will contain an instance of this to avoid more template 
-/// instantiation when using several L9945 chips.
+/// The L9945 instance will contain a reference to this, and L9945core reaches it through
+/// the function table L9945<tInterface> builds, so the driver logic is compiled only once.
 class ExampleL9945interface final {
 public:
   /// Blocking delay in ms.
@@ -72,6 +176,28 @@ public:
   /// @param aChannel channel number from 1 to 8, inclusive.
   void setPwm(float const aValue, uint32_t const aChannel) noexcept;
 
+  /// Optional, if absent L9945::setPwmQ15 converts the value and calls setPwm. Same as setPwm, but the value
+  /// is in Q15 format: -32768 full speed reverse, 0 stop, 32767 full speed forward.
+  void setPwmQ15(int32_t const aValue, L9945<L9945interface>::Bridge const aBridge) noexcept;
+
+  /// Optional, if absent L9945::setPwmQ15 converts the value and calls setPwm. Same as setPwm, but the value
+  /// is in Q15 format: 0 completely closed, 32767 full time open.
+  void setPwmQ15(int32_t const aValue, uint32_t const aChannel) noexcept;
+
+  /// Optional batched variants of the above, used by L9945::setPwmAll and setPwmAllQ15 if present.
+  /// @param aValues 8 values, index 0 for channel 1
+  /// @param aMask   bit 0 for channel 1, only these channels have to be set
+  void setPwmAll(float const * const aValues, uint32_t const aMask) noexcept;
+  void setPwmAll(int32_t const * const aValues, uint32_t const aMask) noexcept;
+
+  /// Optional batched variants for both bridges, used by L9945::setPwmBridges and setPwmBridgesQ15 if present.
+  /// @param aMask bit 0 for bridge 1, bit 1 for bridge 2, only these bridges have to be set
+  void setPwmBridges(float const aBridge1, float const aBridge2, uint32_t const aMask) noexcept;
+  void setPwmBridges(int32_t const aBridge1, int32_t const aBridge2, uint32_t const aMask) noexcept;
+
+  /// Optional free running microsecond clock, used for instrumentation if present.
+  uint32_t getMicros() noexcept;
+
   /// Opens a log session for logging diagnostics. The class instance should store a handle or whatever is neeeded for it.
   void open() noexcept;
 
@@ -84,8 +210,10 @@ public:
 };
 */
 
-template<typename tInterface>
-class L9945 final : public BanCopyMove {
+/// Driver logic independent of the interface type, so it is compiled only once for all the interfaces
+/// in a program. It talks to the application through a Transport table, which L9945<tInterface>
+/// fills from an interface class like the example above.
+class L9945core : public BanCopyMove {
 private:
   static constexpr uint32_t cResetDelay                 = 10u;
   static constexpr uint32_t cCsDelay                    =  1u;
@@ -118,6 +246,11 @@ private:
 
   static constexpr uint32_t cChannelCount               = cMaskChannel + 1u;
   static constexpr uint32_t cNoDelay                    = 0u;
+  static constexpr uint32_t cPwmAllChannels             = 0xffu;
+  static constexpr uint32_t cAllChannels                = 0xffu;
+  static constexpr uint32_t cAllCommands                = (1u << cRegisterCount) - 1u;
+  static constexpr uint32_t cSettingCommands            = 0x1ffu;  // commands 0-8
+  static constexpr uint32_t cPwmBridgeShift             = cChannelCount;
   
 public:
   enum class SpiResult : uint32_t {
@@ -137,6 +270,35 @@ public:
     c2 = 4u
   };
 
+  /// Functions of the application interface, see ExampleL9945interface for their semantics.
+  /// All of them get the context pointer given to the constructor, except mDelayMs.
+  struct Transport final {
+    void      (*mDelayMs)(uint32_t const aDelay);
+    void      (*mEnableReset)(void * const aContext, bool const aEnable);
+    void      (*mEnableAll)(void * const aContext, bool const aEnable);
+    void      (*mFatalError)(void * const aContext, Exception const aException);
+    /// One frame with enableSpiTransfer(true) before and enableSpiTransfer(false) after spiTransmitReceive.
+    SpiResult (*mTransfer)(void * const aContext, uint8_t const * const aTxData, uint8_t * const aRxData, uint16_t const aSize);
+    void      (*mSetPwmChannel)(void * const aContext, float const aValue, uint32_t const aChannel);
+    void      (*mSetPwmBridge)(void * const aContext, float const aValue, Bridge const aBridge);
+    void      (*mSetPwmChannelQ15)(void * const aContext, int32_t const aValue, uint32_t const aChannel);
+    void      (*mSetPwmBridgeQ15)(void * const aContext, int32_t const aValue, Bridge const aBridge);
+    // The rest of the PWM functions and mGetMicros are optional, nullptr if absent.
+    void      (*mSetPwmAll)(void * const aContext, float const * const aValues, uint32_t const aMask);
+    void      (*mSetPwmAllQ15)(void * const aContext, int32_t const * const aValues, uint32_t const aMask);
+    void      (*mSetPwmBridges)(void * const aContext, float const aBridge1, float const aBridge2, uint32_t const aMask);
+    void      (*mSetPwmBridgesQ15)(void * const aContext, int32_t const aBridge1, int32_t const aBridge2, uint32_t const aMask);
+    uint32_t  (*mGetMicros)(void * const aContext);
+    void      (*mOpen)(void * const aContext);
+    void      (*mClose)(void * const aContext);
+    void      (*mAppendText)(void * const aContext, char const * const aText);
+    void      (*mAppendChar)(void * const aContext, char const aChar);
+    void      (*mAppendByte)(void * const aContext, uint8_t const aValue);
+    void      (*mAppendUnsigned)(void * const aContext, uint32_t const aValue);
+    void      (*mAppendBool)(void * const aContext, bool const aValue);
+    void      (*mAppendFloat)(void * const aContext, float const aValue);
+  };
+
   // Mask names come almost unmodified from the data sheet.
   // Enum names tend to be more descriptive.
   // Whenever a bit has not a clean on/off meaning, an enum will be used with descriptive names.
@@ -258,6 +420,7 @@ public:
     cNoOlStgStbFail = 0x010100u,
     cNoDiagDone     = 0x010101u
   };
+  static constexpr uint32_t cDiagnosticCodeCount        = 8u;   // compacted ChannelDiagnostics values
 
 //--------------------------------------------------------------------------------------
   static constexpr uint32_t cMask10bistHwscRequest      = 0x03u <<  5u; // write
@@ -414,6 +577,60 @@ public:
     cHs =  1u << l9945::getRightmost1position(cMask81lsHsConfig81)
   };
   static constexpr uint32_t cMask81enOut81              = 0x01u <<  1u;
+  static constexpr uint32_t cMask81channelConfig81      = cMask81tDiagConfig81 | cMask81ocRead81 | cMask81ocConfig81 | cMask81ocTempComp81 | cMask81ocBattComp81
+                                                        | cMask81tBlankOc81 | cMask81protConfig81 | cMask81ocDsShunt81 | cMask81diagIconfig81
+                                                        | cMask81gccConfig81 | cMask81nPconfig81 | cMask81lsHsConfig81 | cMask81enOut81;
+
+  /// All the channel specific fields of one of the commands 1-8. The bridge and peak & hold settings
+  /// in the same register are not included, they are kept as they are in the write cache.
+  struct ChannelConfig final {
+    ChannelTdiagOff            mTimerDiagOff         = ChannelTdiagOff::c11_25us;
+    ChannelOcThreasholdToRead  mOcThreasholdToRead   = ChannelOcThreasholdToRead::cFixed;
+    uint8_t                    mOcDetectTreshold     = 0u;    // raw 6-bit value, see ocDetectTresholdMicroVolt2bin
+    ChannelOcTempComp          mOcTempCompensation   = ChannelOcTempComp::cNone;
+    bool                       mOcBatteryCompensation = false;
+    ChannelOcBlankTime         mOcBlankTime          = ChannelOcBlankTime::c11us;
+    ChannelOutputReEngage      mOutputReEngage       = ChannelOutputReEngage::cWithControlSignalSwitching;
+    ChannelOutputOcMeasure     mOutputOcMeasure      = ChannelOutputOcMeasure::cDsm;
+    ChannelOlOutCurrCapability mOlOutCurrCapability  = ChannelOlOutCurrCapability::c100uA;
+    ChannelGateCurrent         mGateCurrent          = ChannelGateCurrent::cExternalResistor;
+    ChannelHsFet               mHsFet                = ChannelHsFet::cNmos;
+    ChannelSide                mSide                 = ChannelSide::cLs;
+    bool                       mOutputEnable         = false;
+
+    /// @returns the fields in cMask81channelConfig81, the rest is 0.
+    constexpr uint32_t encode() const noexcept {
+      return static_cast<uint32_t>(mTimerDiagOff) | static_cast<uint32_t>(mOcThreasholdToRead)
+           | (static_cast<uint32_t>(mOcDetectTreshold) << l9945::getRightmost1position(cMask81ocConfig81) & cMask81ocConfig81)
+           | static_cast<uint32_t>(mOcTempCompensation) | (mOcBatteryCompensation ? cMask81ocBattComp81 : 0u)
+           | static_cast<uint32_t>(mOcBlankTime) | static_cast<uint32_t>(mOutputReEngage) | static_cast<uint32_t>(mOutputOcMeasure)
+           | static_cast<uint32_t>(mOlOutCurrCapability) | static_cast<uint32_t>(mGateCurrent) | static_cast<uint32_t>(mHsFet)
+           | static_cast<uint32_t>(mSide) | (mOutputEnable ? cMask81enOut81 : 0u);
+    }
+
+    static constexpr ChannelConfig decode(uint32_t const aRegister) noexcept {
+      ChannelConfig result;
+      decode(aRegister, result);
+      return result;
+    }
+
+    /// Decodes in place, which spares copying the result.
+    static constexpr void decode(uint32_t const aRegister, ChannelConfig &aResult) noexcept {
+      aResult.mTimerDiagOff = static_cast<ChannelTdiagOff>(aRegister & cMask81tDiagConfig81);
+      aResult.mOcThreasholdToRead = static_cast<ChannelOcThreasholdToRead>(aRegister & cMask81ocRead81);
+      aResult.mOcDetectTreshold = static_cast<uint8_t>((aRegister & cMask81ocConfig81) >> l9945::getRightmost1position(cMask81ocConfig81));
+      aResult.mOcTempCompensation = static_cast<ChannelOcTempComp>(aRegister & cMask81ocTempComp81);
+      aResult.mOcBatteryCompensation = (aRegister & cMask81ocBattComp81) > 0u;
+      aResult.mOcBlankTime = static_cast<ChannelOcBlankTime>(aRegister & cMask81tBlankOc81);
+      aResult.mOutputReEngage = static_cast<ChannelOutputReEngage>(aRegister & cMask81protConfig81);
+      aResult.mOutputOcMeasure = static_cast<ChannelOutputOcMeasure>(aRegister & cMask81ocDsShunt81);
+      aResult.mOlOutCurrCapability = static_cast<ChannelOlOutCurrCapability>(aRegister & cMask81diagIconfig81);
+      aResult.mGateCurrent = static_cast<ChannelGateCurrent>(aRegister & cMask81gccConfig81);
+      aResult.mHsFet = static_cast<ChannelHsFet>(aRegister & cMask81nPconfig81);
+      aResult.mSide = static_cast<ChannelSide>(aRegister & cMask81lsHsConfig81);
+      aResult.mOutputEnable = (aRegister & cMask81enOut81) > 0u;
+    }
+  };
 
   static constexpr uint32_t cInitialRegisterValues[] = {
     //10987654321098765432109876543210
@@ -479,22 +696,115 @@ public:
     CurrentSource::cFetTriState, CurrentSource::cFetOn, CurrentSource::cFetOff, CurrentSource::cCompromised, CurrentSource::cCompromised, CurrentSource::cCompromised, CurrentSource::cCompromised, CurrentSource::cCompromised
   };
 
-  uint8_t mDataOut[cSizeofRegister * 2u] = { 0u, 0u, 0u, 0u, 0xf0u, 0u, 0u, 1u }; // last one is invalid command with parity error;
-  uint8_t mDataIn[cSizeofRegister * 2u];
+  static constexpr uint8_t cDummyFrame[cSizeofRegister] = { 0xf0u, 0u, 0u, 1u }; // invalid command with parity error
+
+#ifdef NOWTECH_L9945_SHARED_FRAME_BUFFER
+  static inline uint8_t mDataOut[cSizeofRegister];
+  static inline uint8_t mDataIn[cSizeofRegister];
+#else
+  uint8_t mDataOut[cSizeofRegister];
+  uint8_t mDataIn[cSizeofRegister];
+#endif
 
-  tInterface&        mInterface;
+  Transport const   &mTransport;
+  void * const       mContext;
 
   // Parity is not maintained in these values!
   std::array<uint32_t, cRegisterCount> mReadCache;
+#ifdef NOWTECH_L9945_SINGLE_CACHE
+  // Write cache of commands 0 and 9-13, the rest is in mReadCache.
+  std::array<uint32_t, cRegisterCount - (cCommand8 - cCommand1 + 1u)> mWriteOverlay;
+#else
   std::array<uint32_t, cRegisterCount> mWriteCache;
+#endif
+  // Bit n is set if the last read-back of configuration command n (1-8) matched the write cache.
+  uint32_t                             mVerifiedConfig = 0u;
   bool                                 mSpiFailed = false;
   uint32_t                             mWriteDelay = 0u;
+  // Bits 0-7: channel 1-8 not SPI controlled and not in bridge mode, bits 8-9: bridge 1-2 in bridge mode.
+  uint32_t                             mPwmEligibility = 0u;
+
+  uint32_t& writeCache(uint32_t const aCommand) noexcept {
+#ifdef NOWTECH_L9945_SINGLE_CACHE
+    return aCommand >= cCommand1 && aCommand <= cCommand8 ? mReadCache[aCommand] : mWriteOverlay[aCommand == cCommand0 ? 0u : aCommand - cCommand8];
+#else
+    return mWriteCache[aCommand];
+#endif
+  }
+
+public:
+  /// Recovery from SPI or parity failures without a hardware reset, see recover().
+  struct RecoveryPolicy final {
+    uint8_t mRetriesPerFrame = 0u;     // repetitions of a failed transfer before latching the failure, except writes of commands 9 and 10
+    bool    mAutoRecover     = false;  // if true, the first transfer after a failure calls recover() before anything else
+  };
+
+  struct RecoveryStatistics final {
+    uint32_t mRetries         = 0u;    // transfers repeated according to RecoveryPolicy::mRetriesPerFrame
+    uint32_t mUnknownLatches  = 0u;    // retried command 10 transfers, whose clear-on-read latches were lost with the failed attempt
+    uint32_t mAttempts        = 0u;
+    uint32_t mSuccesses       = 0u;
+    uint32_t mLastDowntimeUs  = 0u;    // downtimes are measured from the failure to the re-enable, only if the interface has getMicros()
+    uint32_t mMaxDowntimeUs   = 0u;
+    uint32_t mTotalDowntimeUs = 0u;
+    uint32_t mDeviceResets    = 0u;    // power-on or nRES resets of the device detected while running
+  };
+
+  /// Called after the configuration has been replayed due to a device reset detected in a command 10 response.
+  /// @param aContext  the pointer given in setDeviceResetCallback
+  /// @param aVerified true if the configuration read back matches the write cache
+  using DeviceResetCallback = void (*)(void * const aContext, bool const aVerified);
+
+  // Resync reads the status commands, rewrite covers all commands holding configuration.
+  static constexpr uint32_t cRecoveryResyncCommands  = (1u << cCommand10) | (1u << cCommand13);
+  static constexpr uint32_t cRecoveryRewriteCommands = 0x1ffu | (1u << cCommand10);
+  static constexpr uint32_t cVerifiableConfig        = 0x1feu;
+
+private:
+  RecoveryPolicy      mRecoveryPolicy;
+  RecoveryStatistics  mRecoveryStatistics;
+  uint32_t            mFailureMicros = 0u;
+  bool                mRecovering = false;
+  bool                mResetting = false;
+  bool                mReplayPending = false;
+  bool                mResetDetected = false;    // the pending replay is due to a POR or nRES latch, not only to unknown latches
+  bool                mReplaying = false;
+  DeviceResetCallback mDeviceResetCallback = nullptr;
+  void               *mDeviceResetContext = nullptr;
+
+  // Sets a flag for its lifetime, and restores it even if fatalError throws meanwhile.
+  class FlagGuard final {
+  private:
+    bool      &mFlag;
+    bool const mPrevious;
+
+  public:
+    FlagGuard(bool &aFlag) noexcept
+    : mFlag(aFlag)
+    , mPrevious(aFlag) {
+      aFlag = true;
+    }
+
+    ~FlagGuard() noexcept {
+      mFlag = mPrevious;
+    }
+  };
 
 public:
-  L9945(tInterface &aInterface)
-  : mInterface(aInterface)
+  /// @param aTransport must outlive the driver, usually a static table
+  /// @param aContext   passed to each function of aTransport
+#ifdef NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT
+  L9945core(Transport const &aTransport, void * const aContext) noexcept
+  : mTransport(aTransport)
+  , mContext(aContext) {
+  }
+#else
+  L9945core(Transport const &aTransport, void * const aContext) noexcept
+  : mTransport(aTransport)
+  , mContext(aContext)
   , mLastResult(this) {
   }
+#endif
 
   void reset();
 
@@ -502,12 +812,143 @@ public:
     return mSpiFailed;
   }
 
+  /// Writes of commands 9 and 10 are never retried, because the repeated frame would trigger their pulse or
+  /// BIST / HWSC request again. Their failure is latched at once. A repeated read of command 10 returns its
+  /// clear-on-read latches already cleared by the failed attempt, so it is counted in
+  /// RecoveryStatistics::mUnknownLatches.
+  void setRecoveryPolicy(RecoveryPolicy const &aPolicy) noexcept {
+    mRecoveryPolicy = aPolicy;
+  }
+
+  RecoveryStatistics const& getRecoveryStatistics() const noexcept {
+    return mRecoveryStatistics;
+  }
+
+  /// Every command 10 response is checked for the POR and nRES latches. If one is set outside reset(),
+  /// the device has lost its configuration, so it is replayed from the write cache in a pipelined
+  /// burst right after the transfer which detected it, then verified and aCallback is called.
+  /// After a retried command 10 read the latches are unknown, so the configuration is replayed as well,
+  /// but this is counted only in RecoveryStatistics::mUnknownLatches, and aCallback is not called.
+  void setDeviceResetCallback(DeviceResetCallback const aCallback, void * const aContext) noexcept {
+    mDeviceResetCallback = aCallback;
+    mDeviceResetContext = aContext;
+  }
+
+  /// Restores the operation after an SPI or parity failure without the hardware reset:
+  /// resyncs by reading the status commands, rewrites the write cache in a pipelined burst
+  /// and verifies the configuration read back. Outputs are re-enabled only if all this succeeds.
+  /// Does not call fatalError, the result tells the outcome.
+  /// @returns true on success or if there was no failure to recover from.
+  bool recover();
+
+  // Exception-free API. These methods never call fatalError, and their failure neither latches
+  // hasSpiEverFailed() nor disables the device, so the caller may retry, recover() or reset().
+  // The first failure stops further transfers of the same call.
+  enum class Status : uint8_t {
+    cOk             = 0u,
+    cCommunication  = 1u,  // the interface reported failure
+    cParity         = 2u,  // parity error in the response
+    cFailed         = 3u,  // hasSpiEverFailed() was already set, nothing was transferred
+    cInvalidCommand = 4u
+  };
+
+  template<typename tValue>
+  struct [[nodiscard]] Result final {
+    tValue mValue;
+    Status mStatus;
+
+    constexpr bool isOk() const noexcept {
+      return mStatus == Status::cOk;
+    }
+  };
+
+private:
+  Status mLastStatus = Status::cOk;
+  bool   mQuiet = false;
+
+public:
+  /// @returns the register content on success, parity bit included.
+  [[nodiscard]] Result<uint32_t> tryRead(uint32_t const aCommand);
+
+  /// @returns the field selected by aFunction, shifted to bit 0.
+  [[nodiscard]] Result<uint32_t> tryReadValue(uint32_t const aCommand, uint32_t const aFunction);
+
+  /// Writes aValue into the write cache, and that into the device.
+  [[nodiscard]] Status tryWrite(uint32_t const aCommand, uint32_t const aValue);
+
+  [[nodiscard]] Status tryWriteFromCache(uint32_t const aCommand) {
+    return aCommand < cRegisterCount ? tryWrite(aCommand, writeCache(aCommand)) : Status::cInvalidCommand;
+  }
+
+  [[nodiscard]] Status tryReadAllIntoCache() {
+    return quietly([this](){ readAllIntoCache(); });
+  }
+
+  [[nodiscard]] Status tryReadStatusIntoCache() {
+    return quietly([this](){ readStatusIntoCache(); });
+  }
+
+  [[nodiscard]] Status tryWriteAllFromCache() {
+    return quietly([this](){ writeAllFromCache(); });
+  }
+
   // @param aValue -1 full speed reverse, 0 stop, 1 full speed forward
   void setPwm(float const aValue, Bridge const aBridge);
 
   // @param aValue 0 closed, 1 full time open
   void setPwm(float const aValue, uint32_t const aChannel);
 
+  // @param aValue Q15: -32768 full speed reverse, 0 stop, 32767 full speed forward
+  void setPwmQ15(int32_t const aValue, Bridge const aBridge);
+
+  // @param aValue Q15: 0 closed, 32767 full time open
+  void setPwmQ15(int32_t const aValue, uint32_t const aChannel);
+
+  /// Sets the channels in aMask (bit 0 for channel 1) which are eligible for external PWM, using
+  /// one setPwmAll call of the interface if present, otherwise one setPwm call per channel.
+  /// @param aValues 8 values, index 0 for channel 1
+  void setPwmAll(float const * const aValues, uint32_t const aMask = cPwmAllChannels) {
+    setPwmChannels(aValues, aMask);
+  }
+
+  void setPwmAllQ15(int32_t const * const aValues, uint32_t const aMask = cPwmAllChannels) {
+    setPwmChannels(aValues, aMask);
+  }
+
+  /// Sets both bridges which are in bridge mode, using one setPwmBridges call of the interface if present.
+  void setPwmBridges(float const aBridge1, float const aBridge2) {
+    setPwmBridgePair(aBridge1, aBridge2);
+  }
+
+  void setPwmBridgesQ15(int32_t const aBridge1, int32_t const aBridge2) {
+    setPwmBridgePair(aBridge1, aBridge2);
+  }
+
+  /// Eligibility is recomputed whenever command 0, 4 or 8 arrives into the read cache.
+  /// @returns bits 0-7 for the channels 1-8 usable by setPwm, bits 8 and 9 for bridge 1 and 2.
+  uint32_t getPwmEligibility() const noexcept {
+    return mPwmEligibility;
+  }
+
+  // Integer conversions for targets without FPU. All of them are exact, so need neither floating point nor lookup tables.
+  static constexpr int32_t adc2milliCelsius(uint32_t const aValue) noexcept {
+    return 280 * static_cast<int32_t>(aValue) - 65000;
+  }
+
+  static constexpr uint32_t adc2milliVolt(uint32_t const aValue) noexcept {
+    return 48u * aValue;
+  }
+
+  // OC thresholds are in 1/1000 units of the float API.
+  static constexpr uint32_t bin2ocDetectTresholdMicroVolt(uint32_t const aValue) noexcept {
+    return 60500u + 15250u * aValue;
+  }
+
+  static constexpr uint32_t ocDetectTresholdMicroVolt2bin(uint32_t const aValue) noexcept {
+    uint32_t raw = (aValue > 60500u ? (aValue - 60500u + 7625u) / 15250u : 0u);
+    return std::min<uint32_t>(raw, cMask81ocConfig81 >> l9945::getRightmost1position(cMask81ocConfig81));
+  }
+
   bool getSpreadSpectrum()                     noexcept { return getBool(cCommand0, cMask0spreadSpectrum); } // 26
   void modifySpreadSpectrum(bool const aValue) noexcept { modifyBool(cCommand0, cMask0spreadSpectrum, aValue); }
   bool readSpreadSpectrum()                             { return readBool(cCommand0, cMask0spreadSpectrum); }
@@ -533,6 +974,10 @@ public:
   uint32_t readSpiOnOutMask(uint32_t const aMask)                               { return readValue(cCommand0, cMask0spiOnOut81) & aMask; };
   bool writeSpiOnOutMask(uint32_t const aValue, uint32_t const aMask)           { return writeValue(cCommand0, cMask0spiOnOut81, aValue, aMask); } 
 
+  /// Single frame variant of writeSpiOnOutMask for frequent switching. The response is not read,
+  /// so the read cache is not updated.
+  bool postSpiOnOutMask(uint32_t const aValue, uint32_t const aMask);
+
   bool getSpiOnOut(uint32_t const aChannel) noexcept;
   void modifySpiOnOut(bool const aValue, uint32_t const aChannel)  noexcept { modifyValue(cCommand0, cMask0spiOnOut81, aValue, aChannel); }  // 1-
   bool readSpiOnOut(uint32_t const aChannel);
@@ -608,7 +1053,8 @@ public:
   /// The caller should check if the 3 ms has elapsed after issuing this command.
   bool writeBistHwscRequest(RequestBist const aValue) { 
     bool result = writeEnum(cCommand10, cMask10bistHwscRequest, static_cast<uint32_t>(aValue));
-    mWriteCache[cCommand10] &= ~cMask10bistHwscRequest;
+    writeCache(cCommand10) &= ~cMask10bistHwscRequest;
+    mVerifiedConfig = 0u;                                  // BIST reverts the configuration
     return result;
   }
  
@@ -717,6 +1163,18 @@ public:
   float getBatteryVoltage()                  noexcept { return bin2voltage(getValue(cCommand13, cMask13vpsAdc)); } // 11-
   float readBatteryVoltage()                          { return bin2voltage(readValue(cCommand13, cMask13vpsAdc)); }
 
+  uint32_t getTemperatureAdc()               noexcept { return getValue(cCommand13, cMask13tempAdc); } // 11-
+  uint32_t readTemperatureAdc()                       { return readValue(cCommand13, cMask13tempAdc); }
+
+  uint32_t getBatteryVoltageAdc()            noexcept { return getValue(cCommand13, cMask13vpsAdc); } // 1-
+  uint32_t readBatteryVoltageAdc()                    { return readValue(cCommand13, cMask13vpsAdc); }
+
+  int32_t getTemperatureMilliCelsius()        noexcept { return adc2milliCelsius(getValue(cCommand13, cMask13tempAdc)); } // 11-
+  int32_t readTemperatureMilliCelsius()                { return adc2milliCelsius(readValue(cCommand13, cMask13tempAdc)); }
+
+  uint32_t getBatteryVoltageMilliVolt()       noexcept { return adc2milliVolt(getValue(cCommand13, cMask13vpsAdc)); } // 1-
+  uint32_t readBatteryVoltageMilliVolt()               { return adc2milliVolt(readValue(cCommand13, cMask13vpsAdc)); }
+
   ChannelTdiagOff getTimerDiagOff(uint32_t const aChannel)                       noexcept { return static_cast<ChannelTdiagOff>(getEnum(channel2command18(aChannel), cMask81tDiagConfig81)); } // 22-
   void modifyTimerDiagOff(ChannelTdiagOff const aValue, uint32_t const aChannel) noexcept { modifyEnum(channel2command18(aChannel), cMask81tDiagConfig81, static_cast<uint32_t>(aValue)); }
   ChannelTdiagOff readTimerDiagOff(uint32_t const aChannel)                               { return static_cast<ChannelTdiagOff>(readEnum(channel2command18(aChannel), cMask81tDiagConfig81)); }
@@ -734,6 +1192,11 @@ public:
   float readOcDetectTreshold(uint32_t const aChannel)                               { return bin2ocDetectTreshold(readValue(channel2command18(aChannel), cMask81ocConfig81)); }
   bool writeOcDetectTreshold(float const aValue, uint32_t const aChannel)           { return writeValue(channel2command18(aChannel), cMask81ocConfig81, ocDetectTreshold2bin(aValue)); }
 
+  uint32_t getOcDetectTresholdMicroVolt(uint32_t const aChannel)                          noexcept { return bin2ocDetectTresholdMicroVolt(getValue(channel2command18(aChannel), cMask81ocConfig81)); } // 15-
+  void modifyOcDetectTresholdMicroVolt(uint32_t const aValue, uint32_t const aChannel)    noexcept { modifyValue(channel2command18(aChannel), cMask81ocConfig81, ocDetectTresholdMicroVolt2bin(aValue)); }
+  uint32_t readOcDetectTresholdMicroVolt(uint32_t const aChannel)                                  { return bin2ocDetectTresholdMicroVolt(readValue(channel2command18(aChannel), cMask81ocConfig81)); }
+  bool writeOcDetectTresholdMicroVolt(uint32_t const aValue, uint32_t const aChannel)              { return writeValue(channel2command18(aChannel), cMask81ocConfig81, ocDetectTresholdMicroVolt2bin(aValue)); }
+
   ChannelOcTempComp getOcTempCompensation(uint32_t const aChannel)                       noexcept { return static_cast<ChannelOcTempComp>(getEnum(channel2command18(aChannel), cMask81ocTempComp81)); } // 13-
   void modifyOcTempCompensation(ChannelOcTempComp const aValue, uint32_t const aChannel) noexcept { modifyEnum(channel2command18(aChannel), cMask81ocTempComp81, static_cast<uint32_t>(aValue)); }
   ChannelOcTempComp readOcTempCompensation(uint32_t const aChannel)                               { return static_cast<ChannelOcTempComp>(readEnum(channel2command18(aChannel), cMask81ocTempComp81)); }
@@ -784,112 +1247,615 @@ public:
   bool readOutputEnable(uint32_t const aChannel)                               { return readBool(channel2command18(aChannel), cMask81enOut81); }
   bool writeOutputEnable(bool const aValue, uint32_t const aChannel)           { return writeBool(channel2command18(aChannel), cMask81enOut81, aValue); }
 
+  ChannelConfig getChannelConfig(uint32_t const aChannel) noexcept {
+    return ChannelConfig::decode(writeCache(channel2command18(aChannel)));
+  }
+
+  /// Updates the write cache of the channels in aMask, like the modify* methods.
+  /// @param aConfigs 8 values, index 0 for channel 1
+  /// @param aMask    bit 0 for channel 1, only these channels are used
+  void modifyChannelConfigs(ChannelConfig const * const aConfigs, uint32_t const aMask = cAllChannels) noexcept;
+
+  /// Reads the configuration of the channels in aMask in one pipelined burst of one frame per channel
+  /// plus a dummy frame. The read cache is updated as well.
+  /// @param aConfigs 8 values, index 0 for channel 1, only the ones in aMask are filled
+  /// @returns true on success.
+  bool readChannelConfigs(ChannelConfig * const aConfigs, uint32_t const aMask = cAllChannels);
+
+  /// Writes the configuration of the channels in aMask in one pipelined burst, 9 frames for all the
+  /// channels instead of 2 per field with the write* methods. The responses verify the configuration.
+  /// @returns true on success.
+  bool writeChannelConfigs(ChannelConfig const * const aConfigs, uint32_t const aMask = cAllChannels);
+
+  /// Unlike the write* methods, the read*IntoCache methods return hasSpiEverFailed(),
+  /// so true means failure.
   bool readAllIntoCache();
   bool readIntoCache(uint32_t const aCommand);
+
+  /// Reads only commands 0 and 9-13. Configuration commands 1-8 are read only if
+  /// their last read-back did not match the write cache.
+  /// @returns true on failure, like readAllIntoCache.
+  bool readStatusIntoCache();
   bool writeAllFromCache();
 
   bool writeFromCache(uint32_t const aCommand) {
-    return write(aCommand, mWriteCache[aCommand]);
+    return write(aCommand, writeCache(aCommand));
   }
 
   uint32_t getReadCache(uint32_t const aCommand) const {
     return mReadCache[aCommand];
   }
 
+  /// Communication check service. When the check is enabled, the device disables its outputs
+  /// if it receives no valid frame within its timeout. Times are given by the caller in ms.
+  struct CommCheckConfig final {
+    uint32_t mTimeoutMs     = 16u;   // device timeout
+    uint32_t mGuardMs       = 2u;    // the refresh is due this much before the deadline, covering the jitter of serviceCommCheck() calls
+    bool     mTrafficCounts = true;  // every valid frame restarts the device timer, so ordinary traffic postpones the refresh
+  };
+
+private:
+  CommCheckConfig mCommCheckConfig;
+  uint32_t        mCommCheckLastMs = 0u;       // latest moment the device timer surely restarted
+  uint32_t        mCommCheckServiceMs = 0u;    // time of the previous serviceCommCheck() call
+  uint32_t        mCommCheckRefreshes = 0u;
+  bool            mCommCheckActive = false;
+  bool            mCommCheckTraffic = false;   // a frame succeeded since the previous serviceCommCheck() call
+
+public:
+  /// Enables the communication check in the device and starts tracking its deadline.
+  /// From now on serviceCommCheck() must be called at least every mTimeoutMs - mGuardMs.
+  bool startCommCheck(uint32_t const aNowMs, CommCheckConfig const &aConfig);
+
+  bool startCommCheck(uint32_t const aNowMs) {
+    return startCommCheck(aNowMs, CommCheckConfig());
+  }
+  bool stopCommCheck();
+
+  /// Sends a single refresh frame, but only if the deadline is within the guard time.
+  /// Ordinary traffic since the previous call is accounted as if it happened at that call.
+  /// @returns true if a refresh frame was sent.
+  bool serviceCommCheck(uint32_t const aNowMs);
+
+  /// @returns the worst case time left until the device deadline, negative if it has been missed.
+  int32_t getCommCheckMarginMs(uint32_t const aNowMs) const noexcept {
+    return static_cast<int32_t>(mCommCheckConfig.mTimeoutMs) - static_cast<int32_t>(aNowMs - mCommCheckLastMs);
+  }
+
+  bool isCommCheckActive() const noexcept {
+    return mCommCheckActive;
+  }
+
+  uint32_t getCommCheckRefreshCount() const noexcept {
+    return mCommCheckRefreshes;
+  }
+
+  // Instrumentation, see NOWTECH_L9945_INSTRUMENTATION
+  enum class Operation : uint8_t {
+    cRead       = 0u, // all read* methods
+    cWrite      = 1u, // all write* methods
+    cReadAll    = 2u, // readAllIntoCache
+    cReadStatus = 3u, // readStatusIntoCache
+    cWriteAll   = 4u, // writeAllFromCache
+    cDiagnose   = 5u, // diagnose
+    cRecover    = 6u, // recover
+    cReadBurst  = 7u, // readChannelConfigs
+    cWriteBurst = 8u, // writeChannelConfigs
+    cReadState  = 9u, // readDeviceState
+    cWriteState = 10u, // writeDeviceState
+    cCount      = 11u
+  };
+
+  // Bucket 0 counts 0 us, bucket n counts [2^(n-1), 2^n) us, the last bucket also counts everything above.
+  static constexpr uint32_t cLatencyBucketCount = 16u;
+
+  struct CommandStatistics final {
+    uint32_t mReads               = 0u;
+    uint32_t mWrites              = 0u;
+    uint32_t mDummyFrames         = 0u;
+    uint32_t mParityErrors        = 0u;
+    uint32_t mCommunicationErrors = 0u;
+  };
+
+  struct LatencyHistogram final {
+    std::array<uint32_t, cLatencyBucketCount> mBuckets = {};
+    uint32_t mCount            = 0u;
+    uint32_t mTotalUs          = 0u;
+    uint32_t mMaxUs            = 0u;
+    uint32_t mPredictedTotalUs = 0u;  // sum of the bus cost predictions using the model given to setBusCostModel
+  };
+
+  struct Statistics final {
+    std::array<CommandStatistics, cRegisterCount>                                mCommands;
+    std::array<LatencyHistogram, static_cast<uint32_t>(Operation::cCount)>       mLatencies;  // only if the interface has getMicros()
+  };
+
+  // Frame tracing, see NOWTECH_L9945_TRACE_LENGTH
+  static constexpr uint32_t cTraceLength = NOWTECH_L9945_TRACE_LENGTH;
+  static_assert((cTraceLength & (cTraceLength - 1u)) == 0u, "NOWTECH_L9945_TRACE_LENGTH must be a power of 2");
+
+  static constexpr uint8_t cTraceFlagDummy    = 1u;   // second frame of a transfer, its response belongs to mCommand
+  static constexpr uint8_t cTraceFlagSpiOk    = 2u;   // the interface reported success
+  static constexpr uint8_t cTraceFlagParityOk = 4u;   // the received word has valid parity
+
+  struct TraceRecord final {
+    uint32_t mTimestamp;  // getMicros() of the interface if present, 0 otherwise
+    uint32_t mTx;
+    uint32_t mRx;
+    uint16_t mDelay;      // ms delay before this frame
+    uint8_t  mCommand;
+    uint8_t  mFlags;
+  };
+
+#if NOWTECH_L9945_TRACE_LENGTH > 0
+  /// @returns the number of frames available, at most cTraceLength.
+  uint32_t getTraceCount() const noexcept {
+    return std::min(mTraceNext, cTraceLength);
+  }
+
+  /// @param aIndex 0 for the oldest available frame
+  TraceRecord const& getTraceRecord(uint32_t const aIndex) const noexcept {
+    return mTrace[(mTraceNext - getTraceCount() + aIndex) & (cTraceLength - 1u)];
+  }
+
+  void clearTrace() noexcept {
+    mTraceNext = 0u;
+  }
+#endif
+
+#ifdef NOWTECH_L9945_INSTRUMENTATION
+  void setBusCostModel(l9945::BusCostModel const &aModel) noexcept {
+    mBusCostModel = aModel;
+  }
+
+  Statistics const& getStatistics() const noexcept {
+    return mStatistics;
+  }
+
+  void clearStatistics() noexcept {
+    mStatistics = Statistics();
+  }
+#endif
+
+  /// RAM usage in bytes of the parts influenced by the configuration macros.
+  struct Footprint final {
+    uint32_t mTotal;                // sizeof(L9945core), the same as sizeof(L9945)
+    uint32_t mCaches;               // read and write caches
+    uint32_t mFrameBuffers;         // per instance
+    uint32_t mSharedFrameBuffers;   // once for all instances
+    uint32_t mDiagnosticsSnapshot;
+    uint32_t mWatches;
+    uint32_t mInstrumentation;      // statistics and bus cost model
+    uint32_t mTrace;
+  };
+
+  static constexpr Footprint getFootprint() noexcept;
+
+  enum class WatchDirection : uint8_t {
+    cAbove = 0u,
+    cBelow = 1u
+  };
+
+  /// Called from inside the SPI transfer which observed the watched field changing its state.
+  /// @param aContext the pointer given on registration
+  /// @param aWatch   index of the watch
+  /// @param aValue   actual value of the watched field
+  /// @param aActive  true if the watch has become active, false if inactive
+  using WatchCallback = void (*)(void * const aContext, uint32_t const aWatch, uint32_t const aValue, bool const aActive);
+
+  static constexpr uint32_t cWatchCount   = NOWTECH_L9945_WATCH_COUNT;
+  static constexpr uint32_t cInvalidWatch = std::numeric_limits<uint32_t>::max();
+
+  /// Registers a watch on a field of a register, which is evaluated on every successful transfer of that register.
+  /// The watch becomes active when the field value reaches aTreshold in aDirection, and becomes inactive
+  /// when the value gets back beyond the treshold by more than aHysteresis.
+  /// @returns the index of the watch or cInvalidWatch if there is no more place.
+  uint32_t addWatch(uint32_t const aCommand, uint32_t const aMask, uint32_t const aTreshold, uint32_t const aHysteresis,
+                    WatchDirection const aDirection, WatchCallback const aCallback, void * const aContext) noexcept;
+
+  uint32_t addTemperatureWatch(uint32_t const aTresholdAdc, uint32_t const aHysteresis, WatchDirection const aDirection, WatchCallback const aCallback, void * const aContext) noexcept {
+    return addWatch(cCommand13, cMask13tempAdc, aTresholdAdc, aHysteresis, aDirection, aCallback, aContext);
+  }
+
+  uint32_t addBatteryVoltageWatch(uint32_t const aTresholdAdc, uint32_t const aHysteresis, WatchDirection const aDirection, WatchCallback const aCallback, void * const aContext) noexcept {
+    return addWatch(cCommand13, cMask13vpsAdc, aTresholdAdc, aHysteresis, aDirection, aCallback, aContext);
+  }
+
+  /// The watch is active while any bit of aMask is 1 in the register.
+  uint32_t addLatchWatch(uint32_t const aCommand, uint32_t const aMask, WatchCallback const aCallback, void * const aContext) noexcept {
+    return addWatch(aCommand, aMask, 1u, 0u, WatchDirection::cAbove, aCallback, aContext);
+  }
+
+  void removeWatch(uint32_t const aWatch) noexcept;
+
   enum class DiagnosticsTest : uint8_t {
     cNone = 0u,
     cAuto = 1u,
     cOffPulse = 2u, // requires 1 ms to finish
     cOnPulse = 3u, // requires 1 ms to finish
-    cBist = 4u  // requires 3 ms to finish
+    cBist = 4u, // requires 3 ms to finish
+    cAutoStatusOnly = 5u, // like cAuto, but reads configuration only if it could not be verified
+    cPulse = 6u // cOffPulse and cOnPulse together in one command, requires 1 ms to finish
   };
 
-  enum class StatusLatch : uint8_t {
-    cBoth0 = 0u,
-    cStatus1 = 1u,
-    cLatch1 = 2u,
-    cBoth1 = 3u
-  };
+  /// Selects the channels for pulse diagnostics using diagnose(PulseDiagnosticsPlanner&) so
+  /// that the oldest covered eligible channels are tested first, at most a given number
+  /// in a tick. A tracked channel eligible in every tick is tested at least once in every
+  /// getCoverageBoundTicks() ticks.
+  class PulseDiagnosticsPlanner final {
+  public:
+    static constexpr uint32_t cMaxAge = std::numeric_limits<uint32_t>::max();   // ages saturate here
 
-  class DiagnosticsResult final {
-    friend class L9945;
   private:
-    static constexpr uint32_t            cWaitForTest[] = { 0u, 0u, 1u, 1u, 3u };
-    static constexpr char                cTextDiagnosticsTest[][10u]    = { "None", "Auto", "OffPulse", "OnPulse", "Bist" };
-    static constexpr char                cTextChannelDiagnostics[][16u] = { "OcPinFail", "OcFail", "StgStbFail", "OlFail", "NoFail", "NoOcFail", "NoOlStgStbFail", "NoDiagDone"};
-    static constexpr char                cTextStatusLatch[][8u]         = { "Both0", "Status1", "Latch1", "Both1" };
-    static constexpr char                cTextCurrentSource[][8u]       = { "Corrupt", "FetOn", "FetOff", "Fet3st"};
-    L9945                               *mParent;
-    DiagnosticsTest                      mTestPerformed = DiagnosticsTest::cNone;
-    std::array<bool, 8u>                 mChannelsDiagnosed;
-    std::array<uint32_t, cRegisterCount> mReadCache;
+    std::array<uint32_t, cChannelCount> mAge;           // ticks since the last pulse diagnostics or the construction
+    uint32_t                            mChannelsPerTick;
+    uint32_t                            mTickPeriodMs;
+    uint8_t                             mTracked;
 
   public:
-    DiagnosticsResult(L9945 *aParent) noexcept : mParent(aParent) {
+    /// @param aChannelsPerTick maximum number of channels disrupted by pulses in one tick, 1-8
+    /// @param aTickPeriodMs    period of calling diagnose(PulseDiagnosticsPlanner&), only used for reporting
+    /// @param aTracked         mask of channels which need coverage, channel 1 on bit 0
+    PulseDiagnosticsPlanner(uint32_t const aChannelsPerTick, uint32_t const aTickPeriodMs, uint8_t const aTracked = 0xffu) noexcept
+    : mChannelsPerTick(std::min<uint32_t>(std::max<uint32_t>(aChannelsPerTick, 1u), cChannelCount))
+    , mTickPeriodMs(aTickPeriodMs)
+    , mTracked(aTracked) {
+      mAge.fill(0u);
     }
 
-    DiagnosticsResult(DiagnosticsResult const&) = default;
-    DiagnosticsResult(DiagnosticsResult&&) = default;
-    DiagnosticsResult& operator=(DiagnosticsResult const&) = default;
-    DiagnosticsResult& operator=(DiagnosticsResult&&) = default;
-
-    uint8_t getSpiOnOut() const noexcept;
-    uint8_t getHsFetIsP() const noexcept;
-    uint8_t getSideIsHs() const noexcept;
-    uint8_t getOutputEnable() const noexcept;
-    std::optional<bool> getBridgeCurrentLimit(Bridge const aBridge) const noexcept;
-    std::optional<ChannelDiagnostics> getChannelDiagnostics(uint32_t const aChannel) const noexcept;
+    /// Ages all the tracked channels by one tick and selects the oldest eligible ones.
+    /// @param aEligible mask of channels where a pulse diagnostics can be performed now
+    /// @returns the selected channels, which are considered covered from now on.
+    uint8_t plan(uint8_t const aEligible) noexcept;
 
-    StatusLatch getEn6disable() const noexcept {
-      return getStatusLatch10(cMask10en6disableState, cMask10en6disableLatch);
+    uint32_t getAge(uint32_t const aChannel) const noexcept {
+      return mAge[(aChannel - 1u) & cMaskChannel];
     }
 
-    bool getVddOvDisableLatch() const noexcept {
-      return (mReadCache[cCommand10] & cMask10vddOvDisableLatch) > 0u;
+    uint32_t getCoverageBoundTicks() const noexcept {
+      uint32_t tracked = 0u;
+      for (uint32_t i = 0u; i < cChannelCount; ++i) {
+        tracked += (mTracked >> i) & 1u;
+      }
+      return (tracked + mChannelsPerTick - 1u) / mChannelsPerTick;
     }
 
-    StatusLatch getVddUvDisable() const noexcept {
-      return getStatusLatch10(cMask10vddUvDisableState, cMask10vddUvDisableLatch);
+    uint32_t getCoverageBoundMs() const noexcept {
+      return getCoverageBoundTicks() * mTickPeriodMs;
     }
 
-    StatusLatch getDeviceDis() const noexcept {
-      return getStatusLatch10(cMask10deviceDisState, cMask10deviceDisLatch);
+    /// @returns the tracked channels not covered within the bound, because they were not eligible often enough.
+    uint8_t getOverdueChannels() const noexcept {
+      uint32_t bound = getCoverageBoundTicks();
+      uint32_t result = 0u;
+      for (uint32_t i = 0u; i < cChannelCount; ++i) {
+        result |= (mAge[i] > bound ? 1u : 0u) << i;
+      }
+      return static_cast<uint8_t>(result & mTracked);
     }
+  };
 
-    StatusLatch getDeviceNdisOn() const noexcept {
-      return getStatusLatch10(cMask10deviceNdisOnState, cMask10deviceNdisOnLatch);
-    }
+  /// All the eight channel diagnostics of command 9 decoded in one pass.
+  /// Codes are compacted ChannelDiagnostics values: bit 0 comes from cMask9diagnosticBit0ch81,
+  /// bit 1 from cMask9diagnosticBit1ch81 and bit 2 from cMask9diagnosticBit2ch81.
+  struct ChannelDiagnosticsSummary final {
+    uint32_t                                  mCodes   = 0u;  // 3 bits per channel, channel 1 on bits 0-2
+    uint8_t                                   mValid   = 0u;  // channel 1 on bit 0
+    std::array<uint8_t, cDiagnosticCodeCount> mClasses = {};  // valid channels having a given code, indexed by the code
 
-    bool getDeviceNdisOutLatch() const noexcept {
-      return (mReadCache[cCommand10] & cMask10deviceNdisOutLatch) > 0u;
+    constexpr uint8_t getMask(ChannelDiagnostics const aClass) const noexcept {
+      return mClasses[compactChannelDiagnostics(aClass)];
     }
-    
-    std::optional<bool> getCommCheckLatch() const noexcept;
-    std::optional<bool> getBistResult() const noexcept;
-    std::optional<bool> getHwscResult() const noexcept;
 
-    StatusLatch getVddOvComp() const noexcept {
-      return getStatusLatch10(cMask10vddOvCompState, cMask10vddOvCompLatch);
+    constexpr uint32_t getCode(uint32_t const aChannel) const noexcept {
+      return (mCodes >> (3u * ((aChannel - 1u) & cMaskChannel))) & 7u;
     }
+  };
 
-    StatusLatch getVddUvComp() const noexcept {
-      return getStatusLatch10(cMask10vddUvCompState, cMask10vddUvCompLatch);
+  static constexpr uint32_t compactChannelDiagnostics(ChannelDiagnostics const aValue) noexcept {
+    uint32_t value = static_cast<uint32_t>(aValue);
+    return (value | value >> 7u | value >> 14u) & 7u;
+  }
+
+  static constexpr ChannelDiagnosticsSummary decodeChannelDiagnostics(uint32_t const aCommand9, uint8_t const aValid) noexcept {
+    ChannelDiagnosticsSummary result;
+    decodeChannelDiagnostics(aCommand9, aValid, result);
+    return result;
+  }
+
+  /// Decodes in place, which spares copying the result.
+  static constexpr void decodeChannelDiagnostics(uint32_t const aCommand9, uint8_t const aValid, ChannelDiagnosticsSummary &aResult) noexcept {
+    uint32_t plane0 = (aCommand9 & cMask9diagnosticBit0ch81) >> l9945::getRightmost1position(cMask9diagnosticBit0ch81);
+    uint32_t plane1 = (aCommand9 & cMask9diagnosticBit1ch81) >> l9945::getRightmost1position(cMask9diagnosticBit1ch81);
+    uint32_t plane2 = (aCommand9 & cMask9diagnosticBit2ch81) >> l9945::getRightmost1position(cMask9diagnosticBit2ch81);
+    aResult.mCodes = 0u;
+    aResult.mValid = aValid;
+    for (uint32_t i = 0u; i < cChannelCount; ++i) {
+      aResult.mCodes |= (((plane0 >> i) & 1u) | ((plane1 >> i) & 1u) << 1u | ((plane2 >> i) & 1u) << 2u) << (3u * i);
     }
+    for (uint32_t code = 0u; code < cDiagnosticCodeCount; ++code) {
+      // (bit - 1) is all ones when the bit of the code is 0, so the plane gets inverted.
+      aResult.mClasses[code] = static_cast<uint8_t>((plane0 ^ ((code & 1u) - 1u)) & (plane1 ^ (((code >> 1u) & 1u) - 1u)) & (plane2 ^ (((code >> 2u) & 1u) - 1u)) & aValid);
+    }
+  }
 
-    bool getPowerOnResetLatch() const noexcept {
-      return (mReadCache[cCommand10] & cMask10powerOnResetLatch) > 0u;
+  ChannelDiagnosticsSummary getAllChannelDiagnostics() const noexcept {
+    return decodeChannelDiagnostics(mReadCache[cCommand9], 0xffu);
+  }
+
+  enum class StatusLatch : uint8_t {
+    cBoth0 = 0u,
+    cStatus1 = 1u,
+    cLatch1 = 2u,
+    cBoth1 = 3u
+  };
+
+  /// The whole device state decoded in one pass from the 14 register values of a snapshot, without
+  /// any run-time mask position calculation. Settings come from commands 0-8, statuses from the
+  /// read-back values of commands 0 and 9-13. The one-shot requests of commands 9 and 10 are not part of it.
+  struct DeviceState final {
+    struct BridgeState final {
+      BridgeDeadTime         mDeadTime           = BridgeDeadTime::c1us;
+      BridgeSelectTdiagTimer mTdiagExtConfig     = BridgeSelectTdiagTimer::cHbridge;
+      BridgeToff             mTOff               = BridgeToff::c31us;
+      bool                   mCurrentLimitEn     = false;
+      BridgeFreewheelLs      mActFreewheelLs     = BridgeFreewheelLs::cPassive;
+      bool                   mBridgeConfig       = false;
+      PeakHoldDiagReport     mPeakHoldDiagReport = PeakHoldDiagReport::cNoOlStgStbFailure;
+      bool                   mPeakHoldConfig     = false;
+      bool                   mCurrentLimit       = false;   // status, meaningful only with current limitation in bridge mode
+    };
+
+    // Settings
+    bool                                     mSpreadSpectrum    = false;
+    bool                                     mEnableDiagnostics = false;
+    uint8_t                                  mSpiInputSelect    = 0u;    // channel 1 on bit 0
+    uint8_t                                  mProtectionDisable = 0u;
+    BatteryFactor                            mBattFactorConfig  = BatteryFactor::cCv;
+    GccOverride                              mGccOverrideConfig = GccOverride::cSelective;
+    std::array<BridgeState, 2u>              mBridges           = {};    // index 0 for bridge 1
+    std::array<ChannelConfig, cChannelCount> mChannels          = {};    // index 0 for channel 1
+
+    // Statuses, channel masks have channel 1 on bit 0
+    uint8_t                                  mOutputVcompared   = 0u;    // raw comparator bits of command 0
+    uint8_t                                  mSpiOnOut          = 0u;    // output on, like DiagnosticsResult::getSpiOnOut
+    ChannelDiagnosticsSummary                mChannelDiagnostics;
+    StatusLatch                              mEn6disable        = StatusLatch::cBoth0;
+    bool                                     mVddOvDisableLatch = false;
+    StatusLatch                              mVddUvDisable      = StatusLatch::cBoth0;
+    StatusLatch                              mDeviceDis         = StatusLatch::cBoth0;
+    StatusLatch                              mDeviceNdisOn      = StatusLatch::cBoth0;
+    bool                                     mDeviceNdisOutLatch = false;
+    bool                                     mCommCheckState    = false;
+    bool                                     mCommCheckLatch    = false;
+    bool                                     mBistDone          = false;
+    bool                                     mBistDisableLatch  = false;
+    bool                                     mHwscDone          = false;
+    bool                                     mHwscDisableLatch  = false;
+    StatusLatch                              mVddOvComp         = StatusLatch::cBoth0;
+    StatusLatch                              mVddUvComp         = StatusLatch::cBoth0;
+    bool                                     mPowerOnResetLatch = false;
+    bool                                     mNresLatch         = false;
+    StatusLatch                              mVcpUv             = StatusLatch::cBoth0;
+    StatusLatch                              mVpsUv             = StatusLatch::cBoth0;
+    uint8_t                                  mExternalFetOn     = 0u;    // like DiagnosticsResult::getExternalFetOnStatus
+    uint8_t                                  mExternalFetCommand = 0u;
+    std::array<CurrentSource, cChannelCount> mCurrentSources    = {};
+    bool                                     mNdisProtectLatch  = false;
+    bool                                     mOverTempState     = false;
+    bool                                     mSdoOvLatch        = false;
+    uint16_t                                 mTemperatureAdc    = 0u;
+    uint16_t                                 mBatteryVoltageAdc = 0u;
+    int32_t                                  mTemperatureMilliCelsius = 0;
+    uint32_t                                 mBatteryVoltageMilliVolt = 0u;
+
+    /// @param aRegisters     register values indexed by the command, parity is ignored
+    /// @param aValidDiagnostics channels whose diagnostic bits in command 9 are valid, see ChannelDiagnosticsSummary::mValid
+    static constexpr DeviceState decode(std::array<uint32_t, cRegisterCount> const &aRegisters, uint8_t const aValidDiagnostics = cAllChannels) noexcept {
+      DeviceState result;
+      decode(aRegisters, result, aValidDiagnostics);
+      return result;
     }
 
-    bool getNresLatch() const noexcept {
-      return (mReadCache[cCommand10] & cMask10nResLatch) > 0u;
+    /// Decodes in place, which spares copying the result. All the fields are overwritten.
+    static constexpr void decode(std::array<uint32_t, cRegisterCount> const &aRegisters, DeviceState &aResult, uint8_t const aValidDiagnostics = cAllChannels) noexcept;
+
+    /// Replaces the settings bits of commands 0-8 in aImage, the rest of aImage is kept.
+    /// The spiOnOut bits of command 0 are not settings, so they are kept as well.
+    constexpr void encode(std::array<uint32_t, cRegisterCount> &aImage) const noexcept;
+
+    /// The settings bits of each command in aImage.
+    static constexpr uint32_t cSettingMasks[cCommand8 + 1u] = {
+      cMask0spreadSpectrum | cMask0enableDiagnostics | cMask0spiInputSelect81 | cMask0protectionDisable81,
+      cMask1bridge1deadTime | cMask1bridge1tDiagExtConfig | cMask81channelConfig81,
+      cMask2bridge1tOff | cMask2battFactorConfig | cMask81channelConfig81,
+      cMask3bridge1currentLimitEn | cMask3bridge1actFreewheelLs | cMask3gccOverrideConfig | cMask81channelConfig81,
+      cMask4bridge1config | cMask4peakHold1diagStrategy | cMask4peakHold1config | cMask81channelConfig81,
+      cMask5bridge2deadTime | cMask5bridge2tDiagExtConfig | cMask81channelConfig81,
+      cMask6bridge2tOff | cMask81channelConfig81,
+      cMask7bridge2currentLimitEn | cMask7bridge2actFreewheelLs | cMask81channelConfig81,
+      cMask8bridge2config | cMask8peakHold2diagStrategy | cMask8peakHold2config | cMask81channelConfig81
+    };
+
+  private:
+    // The shift is a compile time constant, unlike in the get* methods.
+    template<uint32_t tMask>
+    static constexpr uint32_t extract(uint32_t const aRegister) noexcept {
+      constexpr uint32_t cShift = l9945::getRightmost1position(tMask);
+      return (aRegister & tMask) >> cShift;
     }
 
-    StatusLatch getVcpUv() const noexcept {
-      return getStatusLatch10(cMask10vcpUvState, cMask10vcpUvLatch);
+    template<uint32_t tMask>
+    static constexpr uint32_t insert(uint32_t const aValue) noexcept {
+      constexpr uint32_t cShift = l9945::getRightmost1position(tMask);
+      return (aValue << cShift) & tMask;
     }
 
-    StatusLatch getVpsUv() const noexcept {
-      return getStatusLatch10(cMask10vpsUvState, cMask10vpsUvLatch);
+    template<uint32_t tStatus, uint32_t tLatch>
+    static constexpr StatusLatch extractStatusLatch10(uint32_t const aRegister) noexcept {
+      return static_cast<StatusLatch>(extract<tStatus>(aRegister) | extract<tLatch>(aRegister) << 1u);
+    }
+  };
+
+  /// Decodes the read cache, so the settings are the ones last read back from the device.
+  DeviceState getDeviceState() const noexcept {
+    return DeviceState::decode(mReadCache);
+  }
+
+  /// Updates the write cache with the settings in aState, like the modify* methods.
+  void modifyDeviceState(DeviceState const &aState) noexcept;
+
+  /// Reads all the commands in one pipelined burst of 15 frames instead of the 28 of readAllIntoCache,
+  /// and decodes them. The read cache is updated as well.
+  /// @returns true on success.
+  bool readDeviceState(DeviceState &aState);
+
+  /// Writes the settings in aState with commands 0-8 in one pipelined burst of 10 frames.
+  /// The responses verify the configuration.
+  /// @returns true on success.
+  bool writeDeviceState(DeviceState const &aState);
+
+private:
+  // Forwards the output of DiagnosticsResult::log() to the logging functions of the transport.
+  class Logger final {
+  private:
+    Transport const &mTransport;
+    void * const     mContext;
+
+  public:
+    Logger(L9945core const &aParent) noexcept
+    : mTransport(aParent.mTransport)
+    , mContext(aParent.mContext) {
+    }
+
+    void open() noexcept {
+      mTransport.mOpen(mContext);
+    }
+
+    void close() noexcept {
+      mTransport.mClose(mContext);
+    }
+
+    Logger& operator<<(char const * const aText) noexcept {
+      mTransport.mAppendText(mContext, aText);
+      return *this;
+    }
+
+    Logger& operator<<(char const aChar) noexcept {
+      mTransport.mAppendChar(mContext, aChar);
+      return *this;
+    }
+
+    Logger& operator<<(uint8_t const aValue) noexcept {
+      mTransport.mAppendByte(mContext, aValue);
+      return *this;
+    }
+
+    Logger& operator<<(uint32_t const aValue) noexcept {
+      mTransport.mAppendUnsigned(mContext, aValue);
+      return *this;
+    }
+
+    Logger& operator<<(bool const aValue) noexcept {
+      mTransport.mAppendBool(mContext, aValue);
+      return *this;
+    }
+
+    Logger& operator<<(float const aValue) noexcept {
+      mTransport.mAppendFloat(mContext, aValue);
+      return *this;
+    }
+  };
+
+public:
+  class DiagnosticsResult final {
+    friend class L9945core;
+  private:
+    static constexpr uint32_t            cWaitForTest[] = { 0u, 0u, 1u, 1u, 3u, 0u, 1u };
+    static constexpr char                cTextDiagnosticsTest[][16u]    = { "None", "Auto", "OffPulse", "OnPulse", "Bist", "AutoStatusOnly", "Pulse" };
+    static constexpr char                cTextChannelDiagnostics[][16u] = { "OcPinFail", "OcFail", "StgStbFail", "OlFail", "NoFail", "NoOcFail", "NoOlStgStbFail", "NoDiagDone"};
+    static constexpr char                cTextStatusLatch[][8u]         = { "Both0", "Status1", "Latch1", "Both1" };
+    static constexpr char                cTextCurrentSource[][8u]       = { "Corrupt", "FetOn", "FetOff", "Fet3st"};
+    L9945core                           *mParent;
+    DiagnosticsTest                      mTestPerformed = DiagnosticsTest::cNone;
+    uint8_t                              mChannelsDiagnosed = 0u;
+    std::array<uint32_t, cRegisterCount> mReadCache;
+
+  public:
+    DiagnosticsResult(L9945core *aParent) noexcept : mParent(aParent) {
+    }
+
+    DiagnosticsResult(DiagnosticsResult const&) = default;
+    DiagnosticsResult(DiagnosticsResult&&) = default;
+    DiagnosticsResult& operator=(DiagnosticsResult const&) = default;
+    DiagnosticsResult& operator=(DiagnosticsResult&&) = default;
+
+    uint8_t getSpiOnOut() const noexcept;
+    uint8_t getHsFetIsP() const noexcept;
+    uint8_t getSideIsHs() const noexcept;
+    uint8_t getOutputEnable() const noexcept;
+    std::optional<bool> getBridgeCurrentLimit(Bridge const aBridge) const noexcept;
+    std::optional<ChannelDiagnostics> getChannelDiagnostics(uint32_t const aChannel) const noexcept;
+
+    ChannelDiagnosticsSummary getAllChannelDiagnostics() const noexcept {
+      return decodeChannelDiagnostics(mReadCache[cCommand9], getChannelsWithValidDiagnostics());
+    }
+
+    /// Everything in the snapshot at once, much cheaper than calling all the getters.
+    DeviceState getDeviceState() const noexcept {
+      return DeviceState::decode(mReadCache, getChannelsWithValidDiagnostics());
+    }
+
+    StatusLatch getEn6disable() const noexcept {
+      return getStatusLatch10(cMask10en6disableState, cMask10en6disableLatch);
+    }
+
+    bool getVddOvDisableLatch() const noexcept {
+      return (mReadCache[cCommand10] & cMask10vddOvDisableLatch) > 0u;
+    }
+
+    StatusLatch getVddUvDisable() const noexcept {
+      return getStatusLatch10(cMask10vddUvDisableState, cMask10vddUvDisableLatch);
+    }
+
+    StatusLatch getDeviceDis() const noexcept {
+      return getStatusLatch10(cMask10deviceDisState, cMask10deviceDisLatch);
+    }
+
+    StatusLatch getDeviceNdisOn() const noexcept {
+      return getStatusLatch10(cMask10deviceNdisOnState, cMask10deviceNdisOnLatch);
+    }
+
+    bool getDeviceNdisOutLatch() const noexcept {
+      return (mReadCache[cCommand10] & cMask10deviceNdisOutLatch) > 0u;
+    }
+    
+    std::optional<bool> getCommCheckLatch() const noexcept;
+    std::optional<bool> getBistResult() const noexcept;
+    std::optional<bool> getHwscResult() const noexcept;
+
+    StatusLatch getVddOvComp() const noexcept {
+      return getStatusLatch10(cMask10vddOvCompState, cMask10vddOvCompLatch);
+    }
+
+    StatusLatch getVddUvComp() const noexcept {
+      return getStatusLatch10(cMask10vddUvCompState, cMask10vddUvCompLatch);
+    }
+
+    bool getPowerOnResetLatch() const noexcept {
+      return (mReadCache[cCommand10] & cMask10powerOnResetLatch) > 0u;
+    }
+
+    bool getNresLatch() const noexcept {
+      return (mReadCache[cCommand10] & cMask10nResLatch) > 0u;
+    }
+
+    StatusLatch getVcpUv() const noexcept {
+      return getStatusLatch10(cMask10vcpUvState, cMask10vcpUvLatch);
+    }
+
+    StatusLatch getVpsUv() const noexcept {
+      return getStatusLatch10(cMask10vpsUvState, cMask10vpsUvLatch);
     }
 
     uint8_t getExternalFetOnStatus() const noexcept;
@@ -921,11 +1887,22 @@ public:
       return mParent->bin2voltage((mReadCache[cCommand13] & cMask13vpsAdc) >> l9945::getRightmost1position(cMask13vpsAdc));
     }
 
+    int32_t getTemperatureMilliCelsius() const noexcept {
+      return adc2milliCelsius((mReadCache[cCommand13] & cMask13tempAdc) >> l9945::getRightmost1position(cMask13tempAdc));
+    }
+
+    uint32_t getBatteryVoltageMilliVolt() const noexcept {
+      return adc2milliVolt((mReadCache[cCommand13] & cMask13vpsAdc) >> l9945::getRightmost1position(cMask13vpsAdc));
+    }
+
     void log() noexcept;
 
   private:
-    void appendBoolOptional(std::optional<bool> const aResult, char const* const aPresent, char const* const aMissing) noexcept;
+    uint8_t getChannelsWithValidDiagnostics() const noexcept;
+    void appendBoolOptional(Logger &aLogger, std::optional<bool> const aResult, char const* const aPresent, char const* const aMissing) noexcept;
     void perform(DiagnosticsTest const aTest);
+    void perform(PulseDiagnosticsPlanner &aPlanner);
+    void issuePulses(uint32_t const aOffPulse, uint32_t const aOnPulse);
     uint32_t gatherChannels(ChannelOcBlankTime const aTimeLimit, bool const aFetNow) noexcept;
 
     StatusLatch getStatusLatch10(uint32_t const aStatus, uint32_t const aLatch) const noexcept {
@@ -933,13 +1910,194 @@ public:
     }
   };
 
+  // Bus cost prediction. The static ones give the worst case, the others take the actual state into account.
+  static constexpr uint32_t cFramesPerTransfer = 2u;
+
+  static constexpr l9945::BusCost predict(Operation const aOperation) noexcept {
+    l9945::BusCost result;
+    if (aOperation == Operation::cRead || aOperation == Operation::cWrite) {
+      result = l9945::BusCost{ cFramesPerTransfer, 0u };
+    }
+    else if (aOperation == Operation::cDiagnose) {
+      result = predict(DiagnosticsTest::cBist);
+    }
+    else if (aOperation == Operation::cRecover) {
+      result = predictPipelined(cRecoveryResyncCommands) + predictPipelined(cRecoveryRewriteCommands);
+    }
+    else if (aOperation == Operation::cReadBurst || aOperation == Operation::cWriteBurst) {
+      result = predictChannelConfigs(cAllChannels);
+    }
+    else if (aOperation == Operation::cReadState) {
+      result = predictPipelined(cAllCommands);
+    }
+    else if (aOperation == Operation::cWriteState) {
+      result = predictPipelined(cSettingCommands);
+    }
+    else {
+      result = l9945::BusCost{ cFramesPerTransfer * cRegisterCount, 0u };
+    }
+    return result;
+  }
+
+  static constexpr l9945::BusCost predict(DiagnosticsTest const aTest) noexcept {
+    l9945::BusCost result = predict(Operation::cReadAll);
+    if (aTest != DiagnosticsTest::cNone && aTest != DiagnosticsTest::cAuto && aTest != DiagnosticsTest::cAutoStatusOnly) {
+      result = result + l9945::BusCost{ cFramesPerTransfer, DiagnosticsResult::cWaitForTest[static_cast<size_t>(aTest)] };
+    }
+    else { // nothing to do
+    }
+    return result;
+  }
+
+  static constexpr l9945::BusCost predictPipelined(uint32_t const aCommands) noexcept {
+    return l9945::BusCost{ aCommands == 0u ? 0u : l9945::countOnes(aCommands) + 1u, 0u };
+  }
+
+  static constexpr l9945::BusCost predictChannelConfigs(uint32_t const aMask) noexcept {
+    return predictPipelined((aMask & cAllChannels) << cCommand1);
+  }
+
+  static constexpr l9945::BusCost predictReset() noexcept {
+    return l9945::BusCost{ cFramesPerTransfer, 2u * cResetDelay } + predict(Operation::cWriteAll);
+  }
+
+  l9945::BusCost predictReadStatus() const noexcept {
+    uint32_t transfers = cRegisterCount;
+    for (uint32_t command = cCommand1; command <= cCommand8; ++command) {
+      transfers -= (mVerifiedConfig >> command) & 1u;
+    }
+    return l9945::BusCost{ cFramesPerTransfer * transfers, 0u };
+  }
+
+  l9945::BusCost predictDiagnose(DiagnosticsTest const aTest) const noexcept {
+    return aTest == DiagnosticsTest::cAutoStatusOnly ? predictReadStatus() : predict(aTest);
+  }
+
+  /// Performs the test into a result owned by the caller, which is then bound to this driver.
+  void diagnose(DiagnosticsTest const aTest, DiagnosticsResult &aResult) {
+    LatencyProbe probe(*this, Operation::cDiagnose, predictDiagnose(aTest));
+    aResult.mParent = this;
+    aResult.perform(aTest);
+  }
+
+  /// Performs a cPulse diagnostics on the channels selected by the planner into a result owned by the caller.
+  void diagnose(PulseDiagnosticsPlanner &aPlanner, DiagnosticsResult &aResult) {
+    LatencyProbe probe(*this, Operation::cDiagnose, predict(DiagnosticsTest::cPulse));
+    aResult.mParent = this;
+    aResult.perform(aPlanner);
+  }
+
+#ifndef NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT
   DiagnosticsResult& diagnose(DiagnosticsTest const aTest) {
-    mLastResult.perform(aTest);
+    diagnose(aTest, mLastResult);
+    return mLastResult;
+  }
+
+  /// Performs a cPulse diagnostics on the channels selected by the planner.
+  DiagnosticsResult& diagnose(PulseDiagnosticsPlanner &aPlanner) {
+    diagnose(aPlanner, mLastResult);
     return mLastResult;
   }
+#endif
 
 private:
-  DiagnosticsResult mLastResult;
+  struct Watch final {
+    WatchCallback mCallback = nullptr;    // nullptr for unused entries
+    void         *mContext;
+    uint32_t      mMask;
+    uint32_t      mTreshold;
+    uint32_t      mHysteresis;
+    uint8_t       mCommand = 0u;
+    uint8_t       mShift;
+    bool          mAbove;
+    bool          mActive;
+  };
+
+#ifndef NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT
+  DiagnosticsResult                 mLastResult;
+#endif
+  std::array<Watch, cWatchCount>    mWatches;
+  uint32_t                          mWatchedCommands = 0u;   // bit n set if there is a watch on command n
+
+#ifdef NOWTECH_L9945_INSTRUMENTATION
+  Statistics                        mStatistics;
+  l9945::BusCostModel               mBusCostModel;
+
+  // Measures the time between its construction and destruction.
+  class LatencyProbe final {
+  private:
+    L9945core            &mParent;
+    Operation const       mOperation;
+    l9945::BusCost const  mPrediction;
+    uint32_t const        mStart;
+
+  public:
+    LatencyProbe(L9945core &aParent, Operation const aOperation, l9945::BusCost const aPrediction) noexcept
+    : mParent(aParent)
+    , mOperation(aOperation)
+    , mPrediction(aPrediction)
+    , mStart(aParent.getMicros()) {
+    }
+
+    ~LatencyProbe() noexcept {
+      mParent.recordLatency(mOperation, mParent.getMicros() - mStart, mPrediction.getMicros(mParent.mBusCostModel));
+    }
+  };
+
+  void count(uint32_t CommandStatistics::* const aCounter, uint32_t const aCommand) noexcept {
+    if (aCommand < cRegisterCount) {
+      ++(mStatistics.mCommands[aCommand].*aCounter);
+    }
+    else { // nothing to do
+    }
+  }
+
+  void recordLatency(Operation const aOperation, uint32_t const aMicros, uint32_t const aPredictedMicros) noexcept {
+    if (mTransport.mGetMicros != nullptr) {
+      LatencyHistogram &histogram = mStatistics.mLatencies[static_cast<uint32_t>(aOperation)];
+      ++histogram.mBuckets[std::min(l9945::getBitWidth(aMicros), cLatencyBucketCount - 1u)];
+      ++histogram.mCount;
+      histogram.mTotalUs += aMicros;
+      histogram.mMaxUs = std::max(histogram.mMaxUs, aMicros);
+      histogram.mPredictedTotalUs += aPredictedMicros;
+    }
+    else { // nothing to do
+    }
+  }
+#else
+  class LatencyProbe final {
+  public:
+    LatencyProbe(L9945core &, Operation const, l9945::BusCost const) noexcept {
+    }
+  };
+
+  void count(uint32_t CommandStatistics::* const, uint32_t const) noexcept {
+  }
+#endif
+
+#if NOWTECH_L9945_TRACE_LENGTH > 0
+  std::array<TraceRecord, cTraceLength> mTrace;
+  uint32_t                              mTraceNext = 0u;   // total number of frames recorded
+
+  void traceFrame(uint8_t const * const aTx, uint32_t const aCommand, uint32_t const aDelay, SpiResult const aSpiResult, bool const aDummy) noexcept {
+    TraceRecord &record = mTrace[mTraceNext & (cTraceLength - 1u)];
+    ++mTraceNext;
+    record.mTimestamp = getMicros();
+    record.mTx = l9945::bytes2word(aTx);
+    record.mRx = l9945::bytes2word(mDataIn);
+    record.mDelay = static_cast<uint16_t>(aDelay);
+    record.mCommand = static_cast<uint8_t>(aCommand);
+    record.mFlags = (aDummy ? cTraceFlagDummy : 0u) | (aSpiResult == SpiResult::cOk ? cTraceFlagSpiOk : 0u)
+                  | (l9945::calculateParity(record.mRx) != cInvalidParity ? cTraceFlagParityOk : 0u);
+  }
+#else
+  void traceFrame(uint8_t const * const, uint32_t const, uint32_t const, SpiResult const, bool const) noexcept {
+  }
+#endif
+
+  uint32_t getMicros() noexcept {
+    return mTransport.mGetMicros != nullptr ? mTransport.mGetMicros(mContext) : 0u;
+  }
 
 private:
   void setWriteDelay(uint32_t const aWriteDelay) noexcept {
@@ -963,25 +2121,25 @@ private:
   }
 
   void modifyEnum(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput) noexcept {
-    mWriteCache[aCommand] = (mWriteCache[aCommand] & ~aFunction) | aInput;
+    writeCache(aCommand) = (writeCache(aCommand) & ~aFunction) | aInput;
   }
 
   void modifyBool(uint32_t const aCommand, uint32_t const aFunction, bool const aInput) noexcept {
     uint32_t value = (aInput ? 1u : 0u);
-    mWriteCache[aCommand] = (mWriteCache[aCommand] & ~aFunction) | (value << l9945::getRightmost1position(aFunction));
+    writeCache(aCommand) = (writeCache(aCommand) & ~aFunction) | (value << l9945::getRightmost1position(aFunction));
   }
 
   void modifyValue(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput) noexcept {
-    mWriteCache[aCommand] = (mWriteCache[aCommand] & ~aFunction) | (aInput << l9945::getRightmost1position(aFunction) & aFunction);
+    writeCache(aCommand) = (writeCache(aCommand) & ~aFunction) | (aInput << l9945::getRightmost1position(aFunction) & aFunction);
   }
 
   void modifyValue(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput, uint32_t const aMask) noexcept {
-    mWriteCache[aCommand] = (mWriteCache[aCommand] & ~(aFunction & (aMask << l9945::getRightmost1position(aFunction)))) 
+    writeCache(aCommand) = (writeCache(aCommand) & ~(aFunction & (aMask << l9945::getRightmost1position(aFunction)))) 
     | ((aInput & aMask) << l9945::getRightmost1position(aFunction));
   }
 
   void modifyValue(uint32_t const aCommand, uint32_t const aFunction, bool const aInput, uint32_t const aChannel) noexcept {
-    mWriteCache[aCommand] = (mWriteCache[aCommand] & ~(aFunction & (1u << (l9945::getRightmost1position(aFunction) + aChannel - 1u)))) 
+    writeCache(aCommand) = (writeCache(aCommand) & ~(aFunction & (1u << (l9945::getRightmost1position(aFunction) + aChannel - 1u)))) 
     | ((aInput ? 1u : 0u) << (l9945::getRightmost1position(aFunction) + aChannel - 1u));
   }
 
@@ -994,25 +2152,25 @@ private:
   }
 
   bool writeEnum(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput) {
-    return write(aCommand, (mWriteCache[aCommand] & ~aFunction) | aInput);
+    return write(aCommand, (writeCache(aCommand) & ~aFunction) | aInput);
   }
 
   bool writeBool(uint32_t const aCommand, uint32_t const aFunction, bool const aInput) {
     uint32_t value = (aInput ? 1u : 0u);
-    return write(aCommand, (mWriteCache[aCommand] & ~aFunction) | (value << l9945::getRightmost1position(aFunction)));
+    return write(aCommand, (writeCache(aCommand) & ~aFunction) | (value << l9945::getRightmost1position(aFunction)));
   }
 
   bool writeValue(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput) {
-    return write(aCommand, (mWriteCache[aCommand] & ~aFunction) | (aInput << l9945::getRightmost1position(aFunction) & aFunction));
+    return write(aCommand, (writeCache(aCommand) & ~aFunction) | (aInput << l9945::getRightmost1position(aFunction) & aFunction));
   }
 
   bool writeValue(uint32_t const aCommand, uint32_t const aFunction, uint32_t const aInput, uint32_t const aMask) {
-    return write(aCommand, (mWriteCache[aCommand] & ~(aFunction & (aMask << l9945::getRightmost1position(aFunction))))
+    return write(aCommand, (writeCache(aCommand) & ~(aFunction & (aMask << l9945::getRightmost1position(aFunction))))
     | ((aInput & aMask) << l9945::getRightmost1position(aFunction)));
   }
 
   bool writeValue(uint32_t const aCommand, uint32_t const aFunction, bool const aInput, uint32_t const aChannel) {
-    return write(aCommand, (mWriteCache[aCommand] & ~(aFunction & (1u << (l9945::getRightmost1position(aFunction) + aChannel - 1u))))
+    return write(aCommand, (writeCache(aCommand) & ~(aFunction & (1u << (l9945::getRightmost1position(aFunction) + aChannel - 1u))))
     | ((aInput ? 1u : 0u) << (l9945::getRightmost1position(aFunction) + aChannel - 1u)));
   }
 
@@ -1055,192 +2213,877 @@ private:
   // Any combination of concurrent read and write calls have to be avoided
   bool write(uint32_t const aCommand, uint32_t const aValue);
   uint32_t spiTransfer(uint32_t const aCommand, uint32_t const aDelay);
+
+  /// Transfers the commands set in aCommands in ascending order back to back, so the response of each
+  /// frame belongs to the previous command, and only one dummy frame is needed at the end.
+  /// Writes take their value from the write cache.
+  /// @returns false if the communication failed.
+  bool transferPipelined(uint32_t const aCommands, bool const aWrite);
+  SpiResult exchangeFrame(uint8_t const * const aTx, uint32_t const aCommand, uint32_t const aDelay, bool const aDummy, uint32_t &aResponse) noexcept;
+  uint32_t acceptResponse(uint32_t const aCommand, SpiResult const aSpiResult, uint32_t const aResponse);
+  void fail(Exception const aException);
+  void updatePwmEligibility() noexcept;
+
+  template<typename tValue>
+  void setPwmChannels(tValue const * const aValues, uint32_t const aMask);
+
+  template<typename tValue>
+  void setPwmBridgePair(tValue const aBridge1, tValue const aBridge2);
+
+  // A failure in a try* method does not latch mSpiFailed, but stops the transfers until the method returns.
+  bool canTransfer() const noexcept {
+    return !mSpiFailed && (!mQuiet || mLastStatus == Status::cOk);
+  }
+
+  template<typename tFunction>
+  Status quietly(tFunction &&aFunction) {
+    bool quiet = mQuiet;
+    mQuiet = true;
+    mLastStatus = Status::cOk;
+    aFunction();
+    mQuiet = quiet;
+    return mLastStatus;
+  }
+
+  /// Sends a single frame without the dummy one. Its response is not used, and the response
+  /// arriving in the next frame is ignored by all transfers anyway.
+  bool post(uint32_t const aCommand, uint32_t const aValue);
+  void replayIfPending();
+  void updateVerifiedConfig(uint32_t const aCommand, uint32_t const aResponse) noexcept;
+  void evaluateWatches(uint32_t const aCommand, uint32_t const aResponse);
   void prepareDataToSend(uint32_t const aValue) noexcept;
   void avoidInitialCommunicationFailure() noexcept;
+
+  // The one-shot request bits, which a burst restoring the configuration must not send again.
+  static constexpr uint32_t getRequestMask(uint32_t const aCommand) noexcept {
+    return aCommand == cCommand9 ? (cMask9diagOffPulse81 | cMask9diagOnPulse81) : (aCommand == cCommand10 ? cMask10bistHwscRequest : 0u);
+  }
+
+  bool isRequestWrite(uint32_t const aCommand) const noexcept {
+    return (aCommand == cCommand9 || aCommand == cCommand10) && (l9945::bytes2word(mDataOut) & cMaskRead) == 0u;
+  }
 };
 
-template<typename tInterface>
-constexpr uint32_t L9945<tInterface>::cInitialRegisterValues[];
+constexpr uint32_t L9945core::cInitialRegisterValues[];
 
-template<typename tInterface>
-void L9945<tInterface>::reset() {
-  mInterface.enableReset(true);
-  tInterface::delayMs(cResetDelay);
-  mInterface.enableReset(false);
-  tInterface::delayMs(cResetDelay);
-  std::copy(cInitialRegisterValues, cInitialRegisterValues + cRegisterCount, mWriteCache.begin());
+constexpr uint8_t L9945core::cDummyFrame[];
+
+constexpr L9945core::Footprint L9945core::getFootprint() noexcept {
+  Footprint result = { sizeof(L9945core), 0u, 0u, 0u, 0u, 0u, 0u, 0u };
+#ifdef NOWTECH_L9945_SINGLE_CACHE
+  result.mCaches = sizeof(mReadCache) + sizeof(mWriteOverlay);
+#else
+  result.mCaches = sizeof(mReadCache) + sizeof(mWriteCache);
+#endif
+#ifdef NOWTECH_L9945_SHARED_FRAME_BUFFER
+  result.mSharedFrameBuffers = sizeof(mDataOut) + sizeof(mDataIn);
+#else
+  result.mFrameBuffers = sizeof(mDataOut) + sizeof(mDataIn);
+#endif
+#ifndef NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT
+  result.mDiagnosticsSnapshot = sizeof(mLastResult);
+#endif
+  result.mWatches = sizeof(mWatches) + sizeof(mWatchedCommands);
+#ifdef NOWTECH_L9945_INSTRUMENTATION
+  result.mInstrumentation = sizeof(mStatistics) + sizeof(mBusCostModel);
+#endif
+#if NOWTECH_L9945_TRACE_LENGTH > 0
+  result.mTrace = sizeof(mTrace) + sizeof(mTraceNext);
+#endif
+  return result;
+}
+
+inline void L9945core::reset() {
+  FlagGuard resetting(mResetting);
+  mReplayPending = false;
+  mResetDetected = false;
+  mReplaying = false;
+  mTransport.mEnableReset(mContext, true);
+  mTransport.mDelayMs(cResetDelay);
+  mTransport.mEnableReset(mContext, false);
+  mTransport.mDelayMs(cResetDelay);
+  for (uint32_t command = cCommand0; command < cRegisterCount; ++command) {
+    writeCache(command) = cInitialRegisterValues[command];
+  }
+  mVerifiedConfig = 0u;
+  mCommCheckActive = false;
   avoidInitialCommunicationFailure();
   mSpiFailed = false;
   writeAllFromCache();
-  mInterface.enableAll(!mSpiFailed);
+  mTransport.mEnableAll(mContext, !mSpiFailed);
 }
 
-template<typename tInterface>
-void L9945<tInterface>::setPwm(float const aValue, Bridge const aBridge) {
-  if (getBridgeConfig(aBridge)) {
+inline void L9945core::setPwm(float const aValue, Bridge const aBridge) {
+  if ((mPwmEligibility & (1u << (cPwmBridgeShift + static_cast<uint32_t>(aBridge) / 4u))) > 0u) {
     if (!mSpiFailed) {
-      mInterface.setPwm(aValue, aBridge);
+      mTransport.mSetPwmBridge(mContext, aValue, aBridge);
+    }
+    else {
+      mTransport.mSetPwmBridge(mContext, 0.0f, aBridge);
+    }
+  }
+  else { // nothing to do
+  }
+}
+
+inline void L9945core::setPwm(float const aValue, uint32_t const aChannel) {
+  if (aChannel - 1u < cChannelCount && (mPwmEligibility & (1u << (aChannel - 1u))) > 0u) {
+    if (!mSpiFailed) {
+      mTransport.mSetPwmChannel(mContext, aValue, aChannel);
+    }
+    else {
+      mTransport.mSetPwmChannel(mContext, 0.0f, aChannel);
+    }
+  }
+}
+
+inline void L9945core::setPwmQ15(int32_t const aValue, Bridge const aBridge) {
+  if ((mPwmEligibility & (1u << (cPwmBridgeShift + static_cast<uint32_t>(aBridge) / 4u))) > 0u) {
+    if (!mSpiFailed) {
+      mTransport.mSetPwmBridgeQ15(mContext, aValue, aBridge);
+    }
+    else {
+      mTransport.mSetPwmBridgeQ15(mContext, 0, aBridge);
+    }
+  }
+  else { // nothing to do
+  }
+}
+
+inline void L9945core::setPwmQ15(int32_t const aValue, uint32_t const aChannel) {
+  if (aChannel - 1u < cChannelCount && (mPwmEligibility & (1u << (aChannel - 1u))) > 0u) {
+    if (!mSpiFailed) {
+      mTransport.mSetPwmChannelQ15(mContext, aValue, aChannel);
+    }
+    else {
+      mTransport.mSetPwmChannelQ15(mContext, 0, aChannel);
+    }
+  }
+}
+
+template<typename tValue>
+void L9945core::setPwmChannels(tValue const * const aValues, uint32_t const aMask) {
+  static constexpr tValue cZeros[cChannelCount] = {};
+  uint32_t mask = aMask & mPwmEligibility & cPwmAllChannels;
+  tValue const * const values = (mSpiFailed ? cZeros : aValues);
+  void (*batched)(void * const, tValue const * const, uint32_t const);
+  void (*single)(void * const, tValue const, uint32_t const);
+  if constexpr (std::is_same_v<tValue, float>) {
+    batched = mTransport.mSetPwmAll;
+    single = mTransport.mSetPwmChannel;
+  }
+  else {
+    batched = mTransport.mSetPwmAllQ15;
+    single = mTransport.mSetPwmChannelQ15;
+  }
+  if (batched != nullptr) {
+    if (mask > 0u) {
+      batched(mContext, values, mask);
+    }
+    else { // nothing to do
+    }
+  }
+  else {
+    for (uint32_t work = mask; work > 0u; work &= work - 1u) {
+      uint32_t index = l9945::getRightmost1position(work);
+      single(mContext, values[index], index + 1u);
+    }
+  }
+}
+
+template<typename tValue>
+void L9945core::setPwmBridgePair(tValue const aBridge1, tValue const aBridge2) {
+  uint32_t mask = mPwmEligibility >> cPwmBridgeShift;
+  tValue bridge1 = (mSpiFailed ? tValue() : aBridge1);
+  tValue bridge2 = (mSpiFailed ? tValue() : aBridge2);
+  void (*batched)(void * const, tValue const, tValue const, uint32_t const);
+  void (*single)(void * const, tValue const, Bridge const);
+  if constexpr (std::is_same_v<tValue, float>) {
+    batched = mTransport.mSetPwmBridges;
+    single = mTransport.mSetPwmBridge;
+  }
+  else {
+    batched = mTransport.mSetPwmBridgesQ15;
+    single = mTransport.mSetPwmBridgeQ15;
+  }
+  if (batched != nullptr) {
+    if (mask > 0u) {
+      batched(mContext, bridge1, bridge2, mask);
+    }
+    else { // nothing to do
+    }
+  }
+  else {
+    if ((mask & 1u) > 0u) {
+      single(mContext, bridge1, Bridge::c1);
+    }
+    else { // nothing to do
+    }
+    if ((mask & 2u) > 0u) {
+      single(mContext, bridge2, Bridge::c2);
+    }
+    else { // nothing to do
+    }
+  }
+}
+
+inline void L9945core::updatePwmEligibility() noexcept {
+  uint32_t bridges = (getBridgeConfig(Bridge::c1) ? 1u : 0u) | (getBridgeConfig(Bridge::c2) ? 2u : 0u);
+  uint32_t channels = ~((mReadCache[cCommand0] & cMask0spiInputSelect81) >> l9945::getRightmost1position(cMask0spiInputSelect81));
+  channels &= ~(((bridges & 1u) > 0u ? 0x0fu : 0u) | ((bridges & 2u) > 0u ? 0xf0u : 0u));
+  mPwmEligibility = (channels & cPwmAllChannels) | (bridges << cPwmBridgeShift);
+}
+
+inline uint32_t L9945core::addWatch(uint32_t const aCommand, uint32_t const aMask, uint32_t const aTreshold, uint32_t const aHysteresis,
+                                     WatchDirection const aDirection, WatchCallback const aCallback, void * const aContext) noexcept {
+  uint32_t result = cInvalidWatch;
+  if (aCommand < cRegisterCount && aMask != 0u && aCallback != nullptr) {
+    for (uint32_t i = 0u; result == cInvalidWatch && i < cWatchCount; ++i) {
+      if (mWatches[i].mCallback == nullptr) {
+        Watch &watch = mWatches[i];
+        watch.mCallback = aCallback;
+        watch.mContext = aContext;
+        watch.mMask = aMask;
+        watch.mTreshold = aTreshold;
+        watch.mHysteresis = aHysteresis;
+        watch.mCommand = static_cast<uint8_t>(aCommand);
+        watch.mShift = static_cast<uint8_t>(l9945::getRightmost1position(aMask));
+        watch.mAbove = (aDirection == WatchDirection::cAbove);
+        watch.mActive = false;
+        mWatchedCommands |= 1u << aCommand;
+        result = i;
+      }
+      else { // nothing to do
+      }
+    }
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+inline void L9945core::removeWatch(uint32_t const aWatch) noexcept {
+  if (aWatch < cWatchCount) {
+    mWatches[aWatch].mCallback = nullptr;
+    mWatchedCommands = 0u;
+    for (auto const &watch : mWatches) {
+      mWatchedCommands |= (watch.mCallback != nullptr ? 1u : 0u) << watch.mCommand;
+    }
+  }
+  else { // nothing to do
+  }
+}
+
+inline bool L9945core::getSpiOnOut(uint32_t const aChannel) noexcept {
+  ChannelSide side = getSide(aChannel);
+  bool bit = getValue(cCommand0, cMask0outputVcompared81, aChannel);
+  return (bit && side == ChannelSide::cHs) || (!bit && side == ChannelSide::cLs);
+}
+
+inline bool L9945core::readSpiOnOut(uint32_t const aChannel) {
+  readIntoCache(cCommand0);
+  readIntoCache(channel2command18(aChannel));
+  return getSpiOnOut(aChannel);
+}
+
+inline L9945core::ChannelDiagnostics L9945core::readChannelDiagnostics(uint32_t const aChannel) {
+  uint32_t all = readValue(cCommand9, cMask9diagnosticBit2ch81 | cMask9diagnosticBit1ch81 | cMask9diagnosticBit0ch81);
+  return static_cast<ChannelDiagnostics>((all >> aChannel) & cMaskChannelDiagnostics);
+}
+
+inline bool L9945core::getExternalFetOnStatus(uint32_t const aChannel) noexcept {
+  ChannelSide side = getSide(aChannel);
+  bool bit = getValue(channel2command1112(aChannel), cMask1112externalFetState4185, channel18toChannel1458(aChannel));
+  return (bit && side == ChannelSide::cHs) || (!bit && side == ChannelSide::cLs);
+}
+
+inline bool L9945core::readExternalFetOnStatus(uint32_t const aChannel) {
+  readIntoCache(channel2command1112(aChannel));
+  readIntoCache(channel2command18(aChannel));
+  return getExternalFetOnStatus(aChannel);
+}
+
+inline L9945core::CurrentSource L9945core::getCurrentSourceStatus(uint32_t const aChannel) noexcept {
+  uint32_t effectiveChannel = channel18toChannel1458(aChannel) - 1u;
+  ChannelHsFet hsFetPolarity = getHsFet(aChannel);
+  ChannelSide side = getSide(aChannel);
+  uint32_t value = getValue(channel2command1112(aChannel), cMask1112channelPullUpDown15 << (3u * effectiveChannel));
+  return cCurrentSourceDecoder[value | (side == ChannelSide::cHs && hsFetPolarity == ChannelHsFet::cPmos ? 0u : 8u)];
+}
+
+inline L9945core::CurrentSource L9945core::readCurrentSourceStatus(uint32_t const aChannel) {
+  readIntoCache(channel2command1112(aChannel));
+  readIntoCache(channel2command18(aChannel));
+  return getCurrentSourceStatus(aChannel);
+}
+
+inline bool L9945core::readAllIntoCache() { // TODO can be implemented in chained HAL_SPI_Transmit calls without dummy word if needed
+  LatencyProbe probe(*this, Operation::cReadAll, predict(Operation::cReadAll));
+  bool result = true;
+  for (size_t command = 0u; result && command < cRegisterCount; ++command) {
+    read(command);
+  }
+  return mSpiFailed;
+}
+
+inline void L9945core::modifyChannelConfigs(ChannelConfig const * const aConfigs, uint32_t const aMask) noexcept {
+  for (uint32_t work = aMask & cAllChannels; work > 0u; work &= work - 1u) {
+    uint32_t index = l9945::getRightmost1position(work);
+    uint32_t command = cCommand1 + index;
+    writeCache(command) = (writeCache(command) & ~cMask81channelConfig81) | aConfigs[index].encode();
+  }
+}
+
+inline bool L9945core::readChannelConfigs(ChannelConfig * const aConfigs, uint32_t const aMask) {
+  LatencyProbe probe(*this, Operation::cReadBurst, predictChannelConfigs(aMask));
+  bool result = transferPipelined((aMask & cAllChannels) << cCommand1, false);
+  if (result) {
+    for (uint32_t work = aMask & cAllChannels; work > 0u; work &= work - 1u) {
+      uint32_t index = l9945::getRightmost1position(work);
+      aConfigs[index] = ChannelConfig::decode(mReadCache[cCommand1 + index]);
+    }
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+inline bool L9945core::writeChannelConfigs(ChannelConfig const * const aConfigs, uint32_t const aMask) {
+  LatencyProbe probe(*this, Operation::cWriteBurst, predictChannelConfigs(aMask));
+  modifyChannelConfigs(aConfigs, aMask);
+  return transferPipelined((aMask & cAllChannels) << cCommand1, true);
+}
+
+constexpr void L9945core::DeviceState::decode(std::array<uint32_t, cRegisterCount> const &aRegisters, DeviceState &aResult, uint8_t const aValidDiagnostics) noexcept {
+  uint32_t const command0 = aRegisters[cCommand0];
+  aResult.mSpreadSpectrum = extract<cMask0spreadSpectrum>(command0) > 0u;
+  aResult.mEnableDiagnostics = extract<cMask0enableDiagnostics>(command0) > 0u;
+  aResult.mSpiInputSelect = static_cast<uint8_t>(extract<cMask0spiInputSelect81>(command0));
+  aResult.mProtectionDisable = static_cast<uint8_t>(extract<cMask0protectionDisable81>(command0));
+  aResult.mBattFactorConfig = static_cast<BatteryFactor>(aRegisters[cCommand2] & cMask2battFactorConfig);
+  aResult.mGccOverrideConfig = static_cast<GccOverride>(aRegisters[cCommand3] & cMask3gccOverrideConfig);
+  for (uint32_t i = 0u; i < aResult.mBridges.size(); ++i) {
+    uint32_t const offset = i * static_cast<uint32_t>(Bridge::c2);
+    BridgeState &bridge = aResult.mBridges[i];
+    bridge.mDeadTime = static_cast<BridgeDeadTime>(aRegisters[cCommand1 + offset] & cMask1bridge1deadTime);
+    bridge.mTdiagExtConfig = static_cast<BridgeSelectTdiagTimer>(aRegisters[cCommand1 + offset] & cMask1bridge1tDiagExtConfig);
+    bridge.mTOff = static_cast<BridgeToff>(aRegisters[cCommand2 + offset] & cMask2bridge1tOff);
+    bridge.mCurrentLimitEn = (aRegisters[cCommand3 + offset] & cMask3bridge1currentLimitEn) > 0u;
+    bridge.mActFreewheelLs = static_cast<BridgeFreewheelLs>(aRegisters[cCommand3 + offset] & cMask3bridge1actFreewheelLs);
+    bridge.mBridgeConfig = (aRegisters[cCommand4 + offset] & cMask4bridge1config) > 0u;
+    bridge.mPeakHoldDiagReport = static_cast<PeakHoldDiagReport>(aRegisters[cCommand4 + offset] & cMask4peakHold1diagStrategy);
+    bridge.mPeakHoldConfig = (aRegisters[cCommand4 + offset] & cMask4peakHold1config) > 0u;
+  }
+  aResult.mBridges[0].mCurrentLimit = extract<cMask9bridge1currentLimit>(aRegisters[cCommand9]) > 0u;
+  aResult.mBridges[1].mCurrentLimit = extract<cMask9bridge2currentLimit>(aRegisters[cCommand9]) > 0u;
+
+  constexpr uint32_t cPullUpDownShift = l9945::getRightmost1position(cMask1112channelPullUpDown15);
+  constexpr uint32_t cPullUpDownMask = cMask1112channelPullUpDown15 >> cPullUpDownShift;
+  uint32_t sideIsHs = 0u;
+  for (uint32_t i = 0u; i < cChannelCount; ++i) {
+    uint32_t const config = aRegisters[cCommand1 + i];
+    ChannelConfig::decode(config, aResult.mChannels[i]);
+    sideIsHs |= extract<cMask81lsHsConfig81>(config) << i;
+    uint32_t pullUpDown = (aRegisters[cCommand11 + i / 4u] >> (cPullUpDownShift + 3u * (i % 4u))) & cPullUpDownMask;
+    uint32_t hsPmos = cMask81lsHsConfig81 | cMask81nPconfig81;
+    aResult.mCurrentSources[i] = cCurrentSourceDecoder[pullUpDown | ((config & hsPmos) == hsPmos ? 0u : 8u)];
+  }
+  uint32_t const lsMask = ~sideIsHs & cAllChannels;     // LS channels report inverted
+  aResult.mOutputVcompared = static_cast<uint8_t>(extract<cMask0outputVcompared81>(command0));
+  aResult.mSpiOnOut = static_cast<uint8_t>(aResult.mOutputVcompared ^ lsMask);
+  decodeChannelDiagnostics(aRegisters[cCommand9], aValidDiagnostics, aResult.mChannelDiagnostics);
+
+  uint32_t const command10 = aRegisters[cCommand10];
+  aResult.mEn6disable = extractStatusLatch10<cMask10en6disableState, cMask10en6disableLatch>(command10);
+  aResult.mVddOvDisableLatch = extract<cMask10vddOvDisableLatch>(command10) > 0u;
+  aResult.mVddUvDisable = extractStatusLatch10<cMask10vddUvDisableState, cMask10vddUvDisableLatch>(command10);
+  aResult.mDeviceDis = extractStatusLatch10<cMask10deviceDisState, cMask10deviceDisLatch>(command10);
+  aResult.mDeviceNdisOn = extractStatusLatch10<cMask10deviceNdisOnState, cMask10deviceNdisOnLatch>(command10);
+  aResult.mDeviceNdisOutLatch = extract<cMask10deviceNdisOutLatch>(command10) > 0u;
+  aResult.mCommCheckState = extract<cMask10configCommCheckState>(command10) > 0u;
+  aResult.mCommCheckLatch = extract<cMask10commCheckLatch>(command10) > 0u;
+  aResult.mBistDone = extract<cMask10bistDone>(command10) > 0u;
+  aResult.mBistDisableLatch = extract<cMask10bistDisableLatch>(command10) > 0u;
+  aResult.mHwscDone = extract<cMask10hwscDone>(command10) > 0u;
+  aResult.mHwscDisableLatch = extract<cMask10hwscDisableLatch>(command10) > 0u;
+  aResult.mVddOvComp = extractStatusLatch10<cMask10vddOvCompState, cMask10vddOvCompLatch>(command10);
+  aResult.mVddUvComp = extractStatusLatch10<cMask10vddUvCompState, cMask10vddUvCompLatch>(command10);
+  aResult.mPowerOnResetLatch = extract<cMask10powerOnResetLatch>(command10) > 0u;
+  aResult.mNresLatch = extract<cMask10nResLatch>(command10) > 0u;
+  aResult.mVcpUv = extractStatusLatch10<cMask10vcpUvState, cMask10vcpUvLatch>(command10);
+  aResult.mVpsUv = extractStatusLatch10<cMask10vpsUvState, cMask10vpsUvLatch>(command10);
+
+  uint32_t const fetState = extract<cMask1112externalFetState4185>(aRegisters[cCommand11]) | extract<cMask1112externalFetState4185>(aRegisters[cCommand12]) << 4u;
+  aResult.mExternalFetOn = static_cast<uint8_t>(fetState ^ lsMask);
+  aResult.mExternalFetCommand = static_cast<uint8_t>(extract<cMask1112externalFetCommand4185>(aRegisters[cCommand11])
+                                                  | extract<cMask1112externalFetCommand4185>(aRegisters[cCommand12]) << 4u);
+
+  uint32_t const command13 = aRegisters[cCommand13];
+  aResult.mNdisProtectLatch = extract<cMask13ndisProtectLatch>(command13) > 0u;
+  aResult.mOverTempState = extract<cMask13overTempState>(command13) > 0u;
+  aResult.mSdoOvLatch = extract<cMask13sdoOvLatch>(command13) > 0u;
+  aResult.mTemperatureAdc = static_cast<uint16_t>(extract<cMask13tempAdc>(command13));
+  aResult.mBatteryVoltageAdc = static_cast<uint16_t>(extract<cMask13vpsAdc>(command13));
+  aResult.mTemperatureMilliCelsius = adc2milliCelsius(aResult.mTemperatureAdc);
+  aResult.mBatteryVoltageMilliVolt = adc2milliVolt(aResult.mBatteryVoltageAdc);
+}
+
+constexpr void L9945core::DeviceState::encode(std::array<uint32_t, cRegisterCount> &aImage) const noexcept {
+  std::array<uint32_t, cCommand8 + 1u> values = {};
+  values[cCommand0] = (mSpreadSpectrum ? cMask0spreadSpectrum : 0u) | (mEnableDiagnostics ? cMask0enableDiagnostics : 0u)
+                    | insert<cMask0spiInputSelect81>(mSpiInputSelect) | insert<cMask0protectionDisable81>(mProtectionDisable);
+  for (uint32_t i = 0u; i < cChannelCount; ++i) {
+    values[cCommand1 + i] = mChannels[i].encode();
+  }
+  for (uint32_t i = 0u; i < mBridges.size(); ++i) {
+    uint32_t const offset = i * static_cast<uint32_t>(Bridge::c2);
+    BridgeState const &bridge = mBridges[i];
+    values[cCommand1 + offset] |= static_cast<uint32_t>(bridge.mDeadTime) | static_cast<uint32_t>(bridge.mTdiagExtConfig);
+    values[cCommand2 + offset] |= static_cast<uint32_t>(bridge.mTOff);
+    values[cCommand3 + offset] |= (bridge.mCurrentLimitEn ? cMask3bridge1currentLimitEn : 0u) | static_cast<uint32_t>(bridge.mActFreewheelLs);
+    values[cCommand4 + offset] |= (bridge.mBridgeConfig ? cMask4bridge1config : 0u) | static_cast<uint32_t>(bridge.mPeakHoldDiagReport)
+                                | (bridge.mPeakHoldConfig ? cMask4peakHold1config : 0u);
+  }
+  values[cCommand2] |= static_cast<uint32_t>(mBattFactorConfig);
+  values[cCommand3] |= static_cast<uint32_t>(mGccOverrideConfig);
+  for (uint32_t command = cCommand0; command <= cCommand8; ++command) {
+    aImage[command] = (aImage[command] & ~cSettingMasks[command]) | values[command];
+  }
+}
+
+inline void L9945core::modifyDeviceState(DeviceState const &aState) noexcept {
+  std::array<uint32_t, cRegisterCount> image = {};
+  for (uint32_t command = cCommand0; command <= cCommand8; ++command) {
+    image[command] = writeCache(command);
+  }
+  aState.encode(image);
+  for (uint32_t command = cCommand0; command <= cCommand8; ++command) {
+    writeCache(command) = image[command];
+  }
+}
+
+inline bool L9945core::readDeviceState(DeviceState &aState) {
+  LatencyProbe probe(*this, Operation::cReadState, predict(Operation::cReadState));
+  bool result = transferPipelined(cAllCommands, false);
+  if (result) {
+    DeviceState::decode(mReadCache, aState);
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+inline bool L9945core::writeDeviceState(DeviceState const &aState) {
+  LatencyProbe probe(*this, Operation::cWriteState, predict(Operation::cWriteState));
+  modifyDeviceState(aState);
+  return transferPipelined(cSettingCommands, true);
+}
+
+inline bool L9945core::readIntoCache(uint32_t const aCommand) {
+  read(aCommand);
+  return mSpiFailed;
+}
+
+inline bool L9945core::readStatusIntoCache() {
+  LatencyProbe probe(*this, Operation::cReadStatus, predictReadStatus());
+  for (uint32_t command = cCommand0; command < cRegisterCount; ++command) {
+    if (command < cCommand1 || command > cCommand8 || (mVerifiedConfig & (1u << command)) == 0u) {
+      read(command);
+    }
+    else { // nothing to do, the read cache holds the verified device value
+    }
+  }
+  return mSpiFailed;
+}
+
+inline bool L9945core::writeAllFromCache() { // TODO can be implemented in chained HAL_SPI_Transmit calls without dummy word if needed
+  LatencyProbe probe(*this, Operation::cWriteAll, predict(Operation::cWriteAll));
+  bool result = true;
+  for (size_t command = 0u; result && command < cRegisterCount; ++command) {
+    if (!write(command, writeCache(command))) {
+      result = false;
+    }
+    else { // nothing to do
+    }
+  }
+  return result;
+}
+
+inline uint32_t L9945core::read(uint32_t const aCommand) {
+  LatencyProbe probe(*this, Operation::cRead, predict(Operation::cRead));
+  count(&CommandStatistics::mReads, aCommand);
+  prepareDataToSend(cFixedPatternValues[aCommand] | cMaskRead);
+  return spiTransfer(aCommand, cNoDelay);
+}
+
+// Any combination of concurrent read and write calls have to be avoided
+inline bool L9945core::write(uint32_t const aCommand, uint32_t const aValue) {
+  bool result = false;
+  if (aCommand < cRegisterCount) {
+    LatencyProbe probe(*this, Operation::cWrite, predict(Operation::cWrite) + l9945::BusCost{ 0u, mWriteDelay });
+    count(&CommandStatistics::mWrites, aCommand);
+    uint32_t toWrite = (aValue & ~(cMaskRead | cFixedPatternMasks[aCommand])) | cFixedPatternValues[aCommand];
+    writeCache(aCommand) = toWrite;
+    prepareDataToSend(toWrite);
+    uint32_t delay = mWriteDelay;
+    mWriteDelay = cNoDelay;        // prepare for possible exception
+    result = spiTransfer(aCommand, delay) != cInvalidResponse;
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+inline uint32_t L9945core::spiTransfer(uint32_t const aCommand, uint32_t const aDelay) {
+  if (mSpiFailed && mRecoveryPolicy.mAutoRecover && !mRecovering) {
+    recover();
+  }
+  else { // nothing to do
+  }
+  uint32_t result = cInvalidResponse;
+  SpiResult spiResult = SpiResult::cOk;
+  bool retried = false;
+  if (canTransfer() && aCommand < cRegisterCount) {
+    uint32_t retries = (isRequestWrite(aCommand) ? 0u : mRecoveryPolicy.mRetriesPerFrame);
+    for (uint32_t attempt = 0u; attempt <= retries
+                                && (attempt == 0u || spiResult != SpiResult::cOk || l9945::calculateParity(result) == cInvalidParity); ++attempt) {
+      if (attempt > 0u) {
+        ++mRecoveryStatistics.mRetries;
+        retried = true;
+      }
+      else { // nothing to do
+      }
+      spiResult = exchangeFrame(mDataOut, aCommand, cNoDelay, false, result);
+      mTransport.mDelayMs(aDelay);
+      if (spiResult == SpiResult::cOk) {
+        count(&CommandStatistics::mDummyFrames, aCommand);
+        spiResult = exchangeFrame(cDummyFrame, aCommand, aDelay, true, result);
+      }
+      else { // nothing to do
+      }
+    }
+  }
+  else if (mSpiFailed && mLastStatus == Status::cOk) {
+    mLastStatus = Status::cFailed;
+  }
+  else { // nothing to do
+  }
+  result = acceptResponse(aCommand, spiResult, result);
+  if (retried && aCommand == cCommand10 && result != cInvalidResponse) {
+    ++mRecoveryStatistics.mUnknownLatches;
+    if (!mResetting && !mRecovering && !mReplaying) {
+      mReplayPending = true;     // a device reset may have gone unseen, but it is not reported as one
+    }
+    else { // nothing to do
+    }
+  }
+  else { // nothing to do
+  }
+  replayIfPending();
+  return result;
+}
+
+inline bool L9945core::transferPipelined(uint32_t const aCommands, bool const aWrite) {
+  uint32_t previous = cRegisterCount;     // the command the response of the next frame belongs to
+  bool result = canTransfer();
+  for (uint32_t command = cCommand0; aCommands != 0u && result && command <= cRegisterCount; ++command) {
+    if (command == cRegisterCount || (aCommands & (1u << command)) > 0u) {
+      uint8_t const *tx = cDummyFrame;
+      if (command < cRegisterCount) {
+        if (aWrite) {
+          count(&CommandStatistics::mWrites, command);
+          writeCache(command) = (writeCache(command) & ~(cMaskRead | cFixedPatternMasks[command])) | cFixedPatternValues[command];
+          prepareDataToSend(writeCache(command) & ~getRequestMask(command));
+        }
+        else {
+          count(&CommandStatistics::mReads, command);
+          prepareDataToSend(cFixedPatternValues[command] | cMaskRead);
+        }
+        tx = mDataOut;
+      }
+      else {
+        count(&CommandStatistics::mDummyFrames, previous);
+      }
+      uint32_t response = cInvalidResponse;
+      SpiResult spiResult = exchangeFrame(tx, (command < cRegisterCount ? command : previous), cNoDelay, command == cRegisterCount, response);
+      if (previous < cRegisterCount) {
+        result = (acceptResponse(previous, spiResult, response) != cInvalidResponse);
+      }
+      else if (spiResult != SpiResult::cOk) {
+        fail(Exception::cCommunication);
+        result = false;
+      }
+      else { // nothing to do, the first response belongs to no command
+      }
+      previous = command;
+    }
+    else { // nothing to do
+    }
+  }
+  replayIfPending();
+  return result;
+}
+
+inline L9945core::SpiResult L9945core::exchangeFrame(uint8_t const * const aTx, uint32_t const aCommand, uint32_t const aDelay,
+                                                                       bool const aDummy, uint32_t &aResponse) noexcept {
+  SpiResult result = mTransport.mTransfer(mContext, aTx, mDataIn, cSizeofRegister);
+  traceFrame(aTx, aCommand, aDelay, result, aDummy);
+  mCommCheckTraffic = mCommCheckTraffic || result == SpiResult::cOk;
+  aResponse = (result == SpiResult::cOk ? l9945::bytes2word(mDataIn) : cInvalidResponse);
+  return result;
+}
+
+inline uint32_t L9945core::acceptResponse(uint32_t const aCommand, SpiResult const aSpiResult, uint32_t const aResponse) {
+  uint32_t result = aResponse;
+  if (canTransfer()) {
+    if(aSpiResult != SpiResult::cOk) {
+      count(&CommandStatistics::mCommunicationErrors, aCommand);
+      fail(Exception::cCommunication);
+      result = cInvalidResponse;
+    }
+    else if (l9945::calculateParity(result) == cInvalidParity) {
+      count(&CommandStatistics::mParityErrors, aCommand);
+      fail(Exception::cParity);
+      result = cInvalidResponse;
     }
-    else {
-      mInterface.setPwm(0u, aBridge);
+    else if (aCommand == cCommand10 && (result & (cMask10powerOnResetLatch | cMask10nResLatch)) > 0u && !mResetting && !mRecovering && !mReplaying) {
+      mReplayPending = true;     // deferred, because this may be in the middle of a pipelined burst
+      mResetDetected = true;
+    }
+    else { // nothing to do
     }
   }
+  else {
+    result = cInvalidResponse;
+  }
+  updateVerifiedConfig(aCommand, result);
+#ifdef NOWTECH_L9945_SINGLE_CACHE
+  if (aCommand < cCommand1 || aCommand > cCommand8) {
+    mReadCache[aCommand] = result;
+  }
+  else { // nothing to do, this holds the configuration
+  }
+#else
+  mReadCache[aCommand] = result;
+#endif
+  if (aCommand == cCommand0 || aCommand == bridge2command1458(cCommand4, Bridge::c1) || aCommand == bridge2command1458(cCommand4, Bridge::c2)) {
+    updatePwmEligibility();
+  }
+  else { // nothing to do
+  }
+  if (result != cInvalidResponse && (mWatchedCommands & (1u << aCommand)) > 0u) {
+    evaluateWatches(aCommand, result);
+  }
   else { // nothing to do
   }
+  return result;
 }
 
-template<typename tInterface>
-void L9945<tInterface>::setPwm(float const aValue, uint32_t const aChannel) {
-  Bridge bridge = (aChannel <= 4u ? Bridge::c1 : Bridge::c2);
-  if (!getSpiInputSelect(aChannel) && !getBridgeConfig(bridge)) {
-    if (!mSpiFailed) {
-      mInterface.setPwm(aValue, aChannel);
+inline void L9945core::fail(Exception const aException) {
+  mLastStatus = (aException == Exception::cParity ? Status::cParity : Status::cCommunication);
+  if (!mQuiet) {
+    mSpiFailed = true;
+    mFailureMicros = getMicros();
+    mTransport.mEnableAll(mContext, false);
+    if (!mRecovering) {
+      mTransport.mFatalError(mContext, aException);
     }
-    else {
-      mInterface.setPwm(0u, aChannel);
+    else { // nothing to do, recover() reports the outcome
     }
   }
+  else { // nothing to do, the caller of the try* method handles it
+  }
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::getSpiOnOut(uint32_t const aChannel) noexcept {
-  ChannelSide side = getSide(aChannel);
-  bool bit = getValue(cCommand0, cMask0outputVcompared81, aChannel);
-  return (bit && side == ChannelSide::cHs) || (!bit && side == ChannelSide::cLs);
+inline L9945core::template Result<uint32_t> L9945core::tryRead(uint32_t const aCommand) {
+  Result<uint32_t> result{ cInvalidResponse, Status::cInvalidCommand };
+  if (aCommand < cRegisterCount) {
+    result.mStatus = quietly([this, aCommand, &result](){ result.mValue = read(aCommand); });
+  }
+  else { // nothing to do
+  }
+  return result;
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::readSpiOnOut(uint32_t const aChannel) {
-  readIntoCache(cCommand0);
-  readIntoCache(channel2command18(aChannel));
-  return getSpiOnOut(aChannel);
+inline L9945core::template Result<uint32_t> L9945core::tryReadValue(uint32_t const aCommand, uint32_t const aFunction) {
+  Result<uint32_t> result = tryRead(aCommand);
+  result.mValue = (result.mValue & aFunction) >> l9945::getRightmost1position(aFunction);
+  return result;
 }
 
-template<typename tInterface>
-typename L9945<tInterface>::ChannelDiagnostics L9945<tInterface>::readChannelDiagnostics(uint32_t const aChannel) {
-  uint32_t all = readValue(cCommand9, cMask9diagnosticBit2ch81 | cMask9diagnosticBit1ch81 | cMask9diagnosticBit0ch81);
-  return static_cast<ChannelDiagnostics>((all >> aChannel) & cMaskChannelDiagnostics);
+inline L9945core::Status L9945core::tryWrite(uint32_t const aCommand, uint32_t const aValue) {
+  Status result = Status::cInvalidCommand;
+  if (aCommand < cRegisterCount) {
+    result = quietly([this, aCommand, aValue](){ write(aCommand, aValue); });
+  }
+  else { // nothing to do
+  }
+  return result;
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::getExternalFetOnStatus(uint32_t const aChannel) noexcept {
-  ChannelSide side = getSide(aChannel);
-  bool bit = getValue(channel2command1112(aChannel), cMask1112externalFetState4185, channel18toChannel1458(aChannel));
-  return (bit && side == ChannelSide::cHs) || (!bit && side == ChannelSide::cLs);
+inline bool L9945core::post(uint32_t const aCommand, uint32_t const aValue) {
+  bool result = false;
+  if (canTransfer()) {
+    prepareDataToSend(aValue);
+    uint32_t response;
+    if (exchangeFrame(mDataOut, aCommand, cNoDelay, false, response) == SpiResult::cOk) {
+      result = true;
+    }
+    else {
+      count(&CommandStatistics::mCommunicationErrors, aCommand);
+      fail(Exception::cCommunication);
+    }
+  }
+  else { // nothing to do
+  }
+  return result;
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::readExternalFetOnStatus(uint32_t const aChannel) {
-  readIntoCache(channel2command1112(aChannel));
-  readIntoCache(channel2command18(aChannel));
-  return getExternalFetOnStatus(aChannel);
+inline bool L9945core::postSpiOnOutMask(uint32_t const aValue, uint32_t const aMask) {
+  modifyValue(cCommand0, cMask0spiOnOut81, aValue, aMask);
+  writeCache(cCommand0) = (writeCache(cCommand0) & ~(cMaskRead | cFixedPatternMasks[cCommand0])) | cFixedPatternValues[cCommand0];
+  count(&CommandStatistics::mWrites, cCommand0);
+  return post(cCommand0, writeCache(cCommand0));
 }
 
-template<typename tInterface>
-typename L9945<tInterface>::CurrentSource L9945<tInterface>::getCurrentSourceStatus(uint32_t const aChannel) noexcept {
-  uint32_t effectiveChannel = channel18toChannel1458(aChannel) - 1u;
-  ChannelHsFet hsFetPolarity = getHsFet(aChannel);
-  ChannelSide side = getSide(aChannel);
-  uint32_t value = getValue(channel2command1112(aChannel), cMask1112channelPullUpDown15 << (3u * effectiveChannel));
-  return cCurrentSourceDecoder[value | (side == ChannelSide::cHs && hsFetPolarity == ChannelHsFet::cPmos ? 0u : 8u)];
+inline bool L9945core::startCommCheck(uint32_t const aNowMs, CommCheckConfig const &aConfig) {
+  mCommCheckConfig = aConfig;
+  mCommCheckActive = writeConfigCommCheck(RequestCommCheck::cYes);
+  mCommCheckLastMs = aNowMs;
+  mCommCheckServiceMs = aNowMs;
+  mCommCheckTraffic = false;
+  return mCommCheckActive;
 }
 
-template<typename tInterface>
-typename L9945<tInterface>::CurrentSource L9945<tInterface>::readCurrentSourceStatus(uint32_t const aChannel) {
-  readIntoCache(channel2command1112(aChannel));
-  readIntoCache(channel2command18(aChannel));
-  return getCurrentSourceStatus(aChannel);
+inline bool L9945core::stopCommCheck() {
+  mCommCheckActive = false;
+  return writeConfigCommCheck(RequestCommCheck::cNo);
 }
 
-template <typename tInterface>
-bool L9945<tInterface>::readAllIntoCache() { // TODO can be implemented in chained HAL_SPI_Transmit calls without dummy word if needed
-  bool result = true;
-  for (size_t command = 0u; result && command < cRegisterCount; ++command) {
-    mReadCache[command] = read(command);
+inline bool L9945core::serviceCommCheck(uint32_t const aNowMs) {
+  bool result = false;
+  if (mCommCheckActive) {
+    if (mCommCheckConfig.mTrafficCounts && mCommCheckTraffic) {
+      mCommCheckLastMs = mCommCheckServiceMs;
+    }
+    else { // nothing to do
+    }
+    if (aNowMs - mCommCheckLastMs + mCommCheckConfig.mGuardMs >= mCommCheckConfig.mTimeoutMs) {
+      count(&CommandStatistics::mReads, cCommand0);
+      result = post(cCommand0, cFixedPatternValues[cCommand0] | cMaskRead);
+      if (result) {
+        mCommCheckLastMs = aNowMs;
+        ++mCommCheckRefreshes;
+      }
+      else { // nothing to do
+      }
+    }
+    else { // nothing to do
+    }
+    mCommCheckTraffic = false;
+    mCommCheckServiceMs = aNowMs;
   }
-  return mSpiFailed;
+  else { // nothing to do
+  }
+  return result;
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::readIntoCache(uint32_t const aCommand) {
-  mReadCache[aCommand] = read(aCommand);
-  return mSpiFailed;
+inline void L9945core::replayIfPending() {
+  if (mReplayPending && !mReplaying) {
+    bool detected = mResetDetected;
+    mReplayPending = false;
+    mResetDetected = false;
+    mVerifiedConfig = 0u;
+    bool verified;
+    {
+      FlagGuard replaying(mReplaying);
+      verified = transferPipelined(cRecoveryRewriteCommands, true) && (mVerifiedConfig & cVerifiableConfig) == cVerifiableConfig;
+    }
+    if (detected) {
+      ++mRecoveryStatistics.mDeviceResets;
+    }
+    else { // nothing to do
+    }
+    if (detected && mDeviceResetCallback != nullptr) {
+      mDeviceResetCallback(mDeviceResetContext, verified);
+    }
+    else { // nothing to do
+    }
+  }
+  else { // nothing to do
+  }
 }
 
-template<typename tInterface>
-bool L9945<tInterface>::writeAllFromCache() { // TODO can be implemented in chained HAL_SPI_Transmit calls without dummy word if needed
+inline bool L9945core::recover() {
   bool result = true;
-  for (size_t command = 0u; result && command < cRegisterCount; ++command) {
-    if (!write(command, mWriteCache[command])) {
-      result = false;
+  if (mSpiFailed) {
+    LatencyProbe probe(*this, Operation::cRecover, predict(Operation::cRecover));
+    ++mRecoveryStatistics.mAttempts;
+    uint32_t failureMicros = mFailureMicros;
+    mSpiFailed = false;
+    mVerifiedConfig = 0u;
+    {
+      FlagGuard recovering(mRecovering);
+      result = transferPipelined(cRecoveryResyncCommands, false) && transferPipelined(cRecoveryRewriteCommands, true)
+            && (mVerifiedConfig & cVerifiableConfig) == cVerifiableConfig;
     }
-    else { // nothing to do
+    if (result) {
+      uint32_t downtime = getMicros() - failureMicros;
+      ++mRecoveryStatistics.mSuccesses;
+      mRecoveryStatistics.mLastDowntimeUs = downtime;
+      mRecoveryStatistics.mMaxDowntimeUs = std::max(mRecoveryStatistics.mMaxDowntimeUs, downtime);
+      mRecoveryStatistics.mTotalDowntimeUs += downtime;
+      mTransport.mEnableAll(mContext, true);
     }
+    else {
+      mSpiFailed = true;
+      mFailureMicros = failureMicros;
+    }
+  }
+  else { // nothing to do
   }
   return result;
 }
 
-template<typename tInterface>
-uint32_t L9945<tInterface>::read(uint32_t const aCommand) {
-  prepareDataToSend(cFixedPatternValues[aCommand] | cMaskRead);
-  return spiTransfer(aCommand, cNoDelay);
-}
-
-// Any combination of concurrent read and write calls have to be avoided
-template<typename tInterface>
-bool L9945<tInterface>::write(uint32_t const aCommand, uint32_t const aValue) {
-  uint32_t result;
-  uint32_t toWrite = (aValue & ~(cMaskRead | cFixedPatternMasks[aCommand])) | cFixedPatternValues[aCommand];
-  mWriteCache[aCommand] = toWrite;
-  prepareDataToSend(toWrite);
-  uint32_t delay = mWriteDelay;
-  mWriteDelay = cNoDelay;        // prepare for possible exception
-  return spiTransfer(aCommand, delay) != cInvalidResponse;
+inline void L9945core::evaluateWatches(uint32_t const aCommand, uint32_t const aResponse) {
+  for (uint32_t i = 0u; i < cWatchCount; ++i) {
+    Watch &watch = mWatches[i];
+    if (watch.mCallback != nullptr && watch.mCommand == aCommand) {
+      uint32_t value = (aResponse & watch.mMask) >> watch.mShift;
+      bool active;
+      if (watch.mAbove) {
+        active = (watch.mActive ? value + watch.mHysteresis >= watch.mTreshold : value >= watch.mTreshold);
+      }
+      else {
+        active = (watch.mActive ? value <= watch.mTreshold + watch.mHysteresis : value <= watch.mTreshold);
+      }
+      if (active != watch.mActive) {
+        watch.mActive = active;
+        watch.mCallback(watch.mContext, i, value, active);
+      }
+      else { // nothing to do
+      }
+    }
+    else { // nothing to do
+    }
+  }
 }
 
-template<typename tInterface>
-uint32_t L9945<tInterface>::spiTransfer(uint32_t const aCommand, uint32_t const aDelay) {
-  uint32_t result = cInvalidResponse;
-  mInterface.enableSpiTransfer(true);
-  SpiResult spiResult1 = SpiResult::cOk;
-  SpiResult spiResult2 = SpiResult::cOk;
-  bool success = (!mSpiFailed && aCommand < cRegisterCount && (spiResult1 = mInterface.spiTransmitReceive(mDataOut, mDataIn, cSizeofRegister)) == SpiResult::cOk);
-  mInterface.enableSpiTransfer(false);
-  tInterface::delayMs(aDelay);
-  mInterface.enableSpiTransfer(true);
-  if (success && (spiResult2 = mInterface.spiTransmitReceive(mDataOut + cSizeofRegister, mDataIn, cSizeofRegister)) == SpiResult::cOk) {
-    result = (static_cast<uint32_t>(mDataIn[0]) << 24u) |
-      (static_cast<uint32_t>(mDataIn[1]) << 16u) |
-      (static_cast<uint32_t>(mDataIn[2]) << 8u) |
-      mDataIn[3];
-  }
-  else { // nothing to do
-  }
-  mInterface.enableSpiTransfer(false);
-  if (!mSpiFailed) {
-    if(spiResult1 != SpiResult::cOk || spiResult2 != SpiResult::cOk) {
-      mSpiFailed = true;
-      mInterface.enableAll(false);
-      mInterface.fatalError(Exception::cCommunication);
-      result = cInvalidResponse;
-    }
-    else if (l9945::calculateParity(result) == cInvalidParity) {
-      mSpiFailed = true;
-      mInterface.enableAll(false);
-      mInterface.fatalError(Exception::cParity);
-      result = cInvalidResponse;
+inline void L9945core::updateVerifiedConfig(uint32_t const aCommand, uint32_t const aResponse) noexcept {
+  if (aCommand >= cCommand1 && aCommand <= cCommand8) {
+    uint32_t compareMask = ~(cFixedPatternMasks[aCommand] | cMaskRead | cMaskParity);
+    if (aResponse != cInvalidResponse && ((aResponse ^ writeCache(aCommand)) & compareMask) == 0u) {
+      mVerifiedConfig |= 1u << aCommand;
     }
-    else { // nothing to do
+    else {
+      mVerifiedConfig &= ~(1u << aCommand);
     }
   }
   else { // nothing to do
   }
-  mReadCache[aCommand] = result;
-  return result;
 }
 
-template<typename tInterface>
-void L9945<tInterface>::prepareDataToSend(uint32_t const aValue) noexcept {
+inline void L9945core::prepareDataToSend(uint32_t const aValue) noexcept {
   uint32_t actual = aValue ^ l9945::calculateParity(aValue);
   mDataOut[0u] = actual >> 24u;
   mDataOut[1u] = actual >> 16u;
@@ -1248,21 +3091,15 @@ void L9945<tInterface>::prepareDataToSend(uint32_t const aValue) noexcept {
   mDataOut[3u] = actual;
 }
 
-template<typename tInterface>
-void L9945<tInterface>::avoidInitialCommunicationFailure() noexcept {
+inline void L9945core::avoidInitialCommunicationFailure() noexcept {
   uint32_t toWrite = (cInitialRegisterValues[cCommand13] & ~(cMaskRead | cFixedPatternMasks[cCommand13])) | cFixedPatternValues[cCommand13];
-  mWriteCache[cCommand13] = toWrite;
+  writeCache(cCommand13) = toWrite;
   prepareDataToSend(toWrite);
-  mInterface.enableSpiTransfer(true);
-  mInterface.spiTransmitReceive(mDataOut, mDataIn, cSizeofRegister);
-  mInterface.enableSpiTransfer(false);
-  mInterface.enableSpiTransfer(true);
-  mInterface.spiTransmitReceive(mDataOut + cSizeofRegister, mDataIn, cSizeofRegister);
-  mInterface.enableSpiTransfer(false);
+  mTransport.mTransfer(mContext, mDataOut, mDataIn, cSizeofRegister);
+  mTransport.mTransfer(mContext, cDummyFrame, mDataIn, cSizeofRegister);
 }
 
-template<typename tInterface>
-uint8_t L9945<tInterface>::DiagnosticsResult::getSpiOnOut() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getSpiOnOut() const noexcept {
   uint8_t result = (mReadCache[cCommand0] & cMask0outputVcompared81) >> l9945::getRightmost1position(cMask0outputVcompared81);
   for (uint32_t i = 0; i < cChannelCount; ++i) {             // LS 0   HS 1
     result ^= ((mReadCache[i + 1u] & cMask81lsHsConfig81) == 0u ? 1u : 0u) << i;
@@ -1270,8 +3107,7 @@ uint8_t L9945<tInterface>::DiagnosticsResult::getSpiOnOut() const noexcept {
   return result;
 }
 
-template<typename tInterface>
-uint8_t L9945<tInterface>::DiagnosticsResult::getHsFetIsP() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getHsFetIsP() const noexcept {
   uint8_t result = 0u;
   for (uint32_t i = 0; i < cChannelCount; ++i) {
     result |= (((mReadCache[i + 1u] & cMask81nPconfig81) >> l9945::getRightmost1position(cMask81nPconfig81)) & 1u) << i;
@@ -1279,8 +3115,7 @@ uint8_t L9945<tInterface>::DiagnosticsResult::getHsFetIsP() const noexcept {
   return result;
 }
   
-template<typename tInterface>
-uint8_t L9945<tInterface>::DiagnosticsResult::getSideIsHs() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getSideIsHs() const noexcept {
   uint8_t result = 0u;
   for (uint32_t i = 0; i < cChannelCount; ++i) {
     result |= (((mReadCache[i + 1u] & cMask81lsHsConfig81) >> l9945::getRightmost1position(cMask81lsHsConfig81)) & 1u) << i;
@@ -1288,8 +3123,7 @@ uint8_t L9945<tInterface>::DiagnosticsResult::getSideIsHs() const noexcept {
   return result;
 }
   
-template<typename tInterface>
-uint8_t L9945<tInterface>::DiagnosticsResult::getOutputEnable() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getOutputEnable() const noexcept {
   uint8_t result = 0u;
   for (uint32_t i = 0; i < cChannelCount; ++i) {
     result |= (((mReadCache[i + 1u] & cMask81enOut81) >> l9945::getRightmost1position(cMask81enOut81)) & 1u) << i;
@@ -1297,8 +3131,7 @@ uint8_t L9945<tInterface>::DiagnosticsResult::getOutputEnable() const noexcept {
   return result;
 }
 
-template<typename tInterface>
-std::optional<bool> L9945<tInterface>::DiagnosticsResult::getBridgeCurrentLimit(Bridge const aBridge) const noexcept {
+inline std::optional<bool> L9945core::DiagnosticsResult::getBridgeCurrentLimit(Bridge const aBridge) const noexcept {
   uint32_t commandEnable = (aBridge == Bridge::c1 ? cCommand3 : cCommand7);
   uint32_t commandConfig = (aBridge == Bridge::c1 ? cCommand4 : cCommand8);
   uint32_t maskLimit     = (aBridge == Bridge::c1 ? cMask9bridge1currentLimit : cMask9bridge2currentLimit);
@@ -1312,12 +3145,10 @@ std::optional<bool> L9945<tInterface>::DiagnosticsResult::getBridgeCurrentLimit(
   return result;
 }
 
-template<typename tInterface>
-std::optional<typename L9945<tInterface>::ChannelDiagnostics> L9945<tInterface>::DiagnosticsResult::getChannelDiagnostics(uint32_t const aChannel) const noexcept {
+inline std::optional<L9945core::ChannelDiagnostics> L9945core::DiagnosticsResult::getChannelDiagnostics(uint32_t const aChannel) const noexcept {
   uint32_t all = mReadCache[cCommand9] & (cMask9diagnosticBit2ch81 | cMask9diagnosticBit1ch81 | cMask9diagnosticBit0ch81);
   std::optional<ChannelDiagnostics> result;
-  if (aChannel > 0u && aChannel <= cChannelCount && mChannelsDiagnosed[aChannel - 1u] > 0u &&
-    (mTestPerformed == DiagnosticsTest::cAuto || mTestPerformed == DiagnosticsTest::cOffPulse || mTestPerformed == DiagnosticsTest::cOnPulse)) {
+  if (aChannel > 0u && aChannel <= cChannelCount && (getChannelsWithValidDiagnostics() & (1u << (aChannel - 1u))) > 0u) {
     result = static_cast<ChannelDiagnostics>((all >> aChannel) & cMaskChannelDiagnostics);
   }
   else { // nothing to do
@@ -1325,8 +3156,19 @@ std::optional<typename L9945<tInterface>::ChannelDiagnostics> L9945<tInterface>:
   return result;
 }
 
-template<typename tInterface>
-std::optional<bool> L9945<tInterface>::DiagnosticsResult::getCommCheckLatch() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getChannelsWithValidDiagnostics() const noexcept {
+  uint8_t result = 0u;
+  if (mTestPerformed == DiagnosticsTest::cAuto || mTestPerformed == DiagnosticsTest::cAutoStatusOnly ||
+    mTestPerformed == DiagnosticsTest::cOffPulse || mTestPerformed == DiagnosticsTest::cOnPulse ||
+    mTestPerformed == DiagnosticsTest::cPulse) {
+    result = mChannelsDiagnosed;
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+inline std::optional<bool> L9945core::DiagnosticsResult::getCommCheckLatch() const noexcept {
   std::optional<bool> result;
   if ((mReadCache[cCommand10] & cMask10configCommCheckState) > 0u) {
     result = (mReadCache[cCommand10] & cMask10commCheckLatch) > 0u;
@@ -1336,8 +3178,7 @@ std::optional<bool> L9945<tInterface>::DiagnosticsResult::getCommCheckLatch() co
   return result;
 }
 
-template<typename tInterface>
-std::optional<bool> L9945<tInterface>::DiagnosticsResult::getBistResult() const noexcept {
+inline std::optional<bool> L9945core::DiagnosticsResult::getBistResult() const noexcept {
   std::optional<bool> result;
   if (mTestPerformed == DiagnosticsTest::cBist && (mReadCache[cCommand10] & cMask10bistDone) > 0u) {
     result = (mReadCache[cCommand10] & cMask10bistDisableLatch) > 0u;
@@ -1347,8 +3188,7 @@ std::optional<bool> L9945<tInterface>::DiagnosticsResult::getBistResult() const
   return result;
 }
 
-template<typename tInterface>
-std::optional<bool> L9945<tInterface>::DiagnosticsResult::getHwscResult() const noexcept {
+inline std::optional<bool> L9945core::DiagnosticsResult::getHwscResult() const noexcept {
   std::optional<bool> result;
   if (mTestPerformed == DiagnosticsTest::cBist && (mReadCache[cCommand10] & cMask10hwscDone) > 0u) {
     result = (mReadCache[cCommand10] & cMask10hwscDisableLatch) > 0u;
@@ -1358,8 +3198,7 @@ std::optional<bool> L9945<tInterface>::DiagnosticsResult::getHwscResult() const
   return result;
 }
 
-template<typename tInterface>
-uint8_t L9945<tInterface>::DiagnosticsResult::getExternalFetOnStatus() const noexcept {
+inline uint8_t L9945core::DiagnosticsResult::getExternalFetOnStatus() const noexcept {
   uint8_t result = (mReadCache[cCommand11] & cMask1112externalFetState4185) >> l9945::getRightmost1position(cMask1112externalFetState4185);
   result |= ((mReadCache[cCommand12] & cMask1112externalFetState4185) << 4u) >> l9945::getRightmost1position(cMask1112externalFetState4185);
   for (uint32_t i = 0; i < cChannelCount; ++i) {             // LS 0   HS 1
@@ -1368,8 +3207,7 @@ uint8_t L9945<tInterface>::DiagnosticsResult::getExternalFetOnStatus() const noe
   return result;
 }
 
-template<typename tInterface>
-typename L9945<tInterface>::CurrentSource L9945<tInterface>::DiagnosticsResult::getCurrentSourceStatus(uint32_t const aChannel) const noexcept {
+inline L9945core::CurrentSource L9945core::DiagnosticsResult::getCurrentSourceStatus(uint32_t const aChannel) const noexcept {
   CurrentSource result;
   if (aChannel > 0u && aChannel <= cChannelCount) {
     uint32_t effectiveChannel = mParent->channel18toChannel1458(aChannel) - 1u;
@@ -1385,96 +3223,116 @@ typename L9945<tInterface>::CurrentSource L9945<tInterface>::DiagnosticsResult::
   return result;
 }
 
-template<typename tInterface>
-void L9945<tInterface>::DiagnosticsResult::log() noexcept {
-  mParent->mInterface.open();
-  mParent->mInterface << "Test: " << cTextDiagnosticsTest[static_cast<size_t>(mTestPerformed)] << '\n';
-  mParent->mInterface << "HS PFET: " << getHsFetIsP() << '\n';
-  mParent->mInterface << "channel HS: " << getSideIsHs() << '\n';
-  mParent->mInterface << "out on: " << getSpiOnOut() << '\n';
-  mParent->mInterface << "out en: " << getOutputEnable() << '\n';
-  appendBoolOptional(getBridgeCurrentLimit(Bridge::c1), "bridge 1 curr lim: ", "bridge 1 curr lim N/A");
-  appendBoolOptional(getBridgeCurrentLimit(Bridge::c2), "bridge 2 curr lim: ", "bridge 2 curr lim N/A");
+inline void L9945core::DiagnosticsResult::log() noexcept {
+  Logger logger(*mParent);
+  logger.open();
+  logger << "Test: " << cTextDiagnosticsTest[static_cast<size_t>(mTestPerformed)] << '\n';
+  logger << "HS PFET: " << getHsFetIsP() << '\n';
+  logger << "channel HS: " << getSideIsHs() << '\n';
+  logger << "out on: " << getSpiOnOut() << '\n';
+  logger << "out en: " << getOutputEnable() << '\n';
+  appendBoolOptional(logger, getBridgeCurrentLimit(Bridge::c1), "bridge 1 curr lim: ", "bridge 1 curr lim N/A");
+  appendBoolOptional(logger, getBridgeCurrentLimit(Bridge::c2), "bridge 2 curr lim: ", "bridge 2 curr lim N/A");
+  ChannelDiagnosticsSummary channelDiagnostics = getAllChannelDiagnostics();
   for (uint32_t i = 1u; i <= cChannelCount; ++i) {
-    std::optional<ChannelDiagnostics> result = getChannelDiagnostics(i);
-    if (result) {
-      uint32_t value = static_cast<uint32_t>(*result);
-      uint32_t compacted = (value | value >> 7u | value >> 14u) & 7u;
-      mParent->mInterface << "channel " << i << " diag: " << cTextChannelDiagnostics[compacted] << '\n';
+    if ((channelDiagnostics.mValid & (1u << (i - 1u))) > 0u) {
+      logger << "channel " << i << " diag: " << cTextChannelDiagnostics[channelDiagnostics.getCode(i)] << '\n';
     }
     else {
-      mParent->mInterface << "channel " << i << " diag: N/A\n";
-    }
-  }
-  mParent->mInterface << "dis: EN6: " << cTextStatusLatch[static_cast<size_t>(getEn6disable())] << '\n';
-  mParent->mInterface << "dis: Vdd OV latch: " << getVddOvDisableLatch() << '\n';
-  mParent->mInterface << "dis: Vdd UV: " << cTextStatusLatch[static_cast<size_t>(getVddUvDisable())] << '\n';
-  mParent->mInterface << "dis: pin DIS: " << cTextStatusLatch[static_cast<size_t>(getDeviceDis())] << '\n';
-  mParent->mInterface << "dis: pin NDIS: " << cTextStatusLatch[static_cast<size_t>(getDeviceNdisOn())] << '\n';
-  mParent->mInterface << "nDIS out latch: " << getDeviceNdisOutLatch() << '\n';
-  appendBoolOptional(getCommCheckLatch(), "comm error: ", "comm error N/A");
-  appendBoolOptional(getBistResult(), "BIST: ", "BIST N/A");
-  appendBoolOptional(getHwscResult(), "HWSC: ", "HWSC N/A");
-  mParent->mInterface << "Vdd OV: " << cTextStatusLatch[static_cast<size_t>(getVddOvComp())] << '\n';
-  mParent->mInterface << "Vdd UV: " << cTextStatusLatch[static_cast<size_t>(getVddUvComp())] << '\n';
-  mParent->mInterface << "POR latch: " << getPowerOnResetLatch() << '\n';
-  mParent->mInterface << "nRES latch: " << getNresLatch() << '\n';
-  mParent->mInterface << "CP UV: " << cTextStatusLatch[static_cast<size_t>(getVcpUv())] << '\n';
-  mParent->mInterface << "Vps UV: " << cTextStatusLatch[static_cast<size_t>(getVpsUv())] << '\n';
-  mParent->mInterface << "FET status: " << getExternalFetOnStatus() << '\n';
-  mParent->mInterface << "FET cmd: " << getExternalFetCommand() << '\n';
-  for (uint32_t i = 1u; i <= cChannelCount; ++i) {
-    mParent->mInterface << "channel " << i << " curr src: " << cTextCurrentSource[static_cast<size_t>(getCurrentSourceStatus(i))] << '\n';
+      logger << "channel " << i << " diag: N/A\n";
+    }
   }
-  mParent->mInterface << "nDIS protect latch: " << getNdisProtectLatch() << '\n';
-  mParent->mInterface << "overtemp latch: " << getOverTempState() << '\n';
-  mParent->mInterface << "SPI SDO OV latch: " << getSdoOvLatch() << '\n';
-  mParent->mInterface << "temperature: " << getTemperature() << '\n';
-  mParent->mInterface << "Vps: " << getBatteryVoltage() << '\n';
-  mParent->mInterface.close();
+  logger << "dis: EN6: " << cTextStatusLatch[static_cast<size_t>(getEn6disable())] << '\n';
+  logger << "dis: Vdd OV latch: " << getVddOvDisableLatch() << '\n';
+  logger << "dis: Vdd UV: " << cTextStatusLatch[static_cast<size_t>(getVddUvDisable())] << '\n';
+  logger << "dis: pin DIS: " << cTextStatusLatch[static_cast<size_t>(getDeviceDis())] << '\n';
+  logger << "dis: pin NDIS: " << cTextStatusLatch[static_cast<size_t>(getDeviceNdisOn())] << '\n';
+  logger << "nDIS out latch: " << getDeviceNdisOutLatch() << '\n';
+  appendBoolOptional(logger, getCommCheckLatch(), "comm error: ", "comm error N/A");
+  appendBoolOptional(logger, getBistResult(), "BIST: ", "BIST N/A");
+  appendBoolOptional(logger, getHwscResult(), "HWSC: ", "HWSC N/A");
+  logger << "Vdd OV: " << cTextStatusLatch[static_cast<size_t>(getVddOvComp())] << '\n';
+  logger << "Vdd UV: " << cTextStatusLatch[static_cast<size_t>(getVddUvComp())] << '\n';
+  logger << "POR latch: " << getPowerOnResetLatch() << '\n';
+  logger << "nRES latch: " << getNresLatch() << '\n';
+  logger << "CP UV: " << cTextStatusLatch[static_cast<size_t>(getVcpUv())] << '\n';
+  logger << "Vps UV: " << cTextStatusLatch[static_cast<size_t>(getVpsUv())] << '\n';
+  logger << "FET status: " << getExternalFetOnStatus() << '\n';
+  logger << "FET cmd: " << getExternalFetCommand() << '\n';
+  for (uint32_t i = 1u; i <= cChannelCount; ++i) {
+    logger << "channel " << i << " curr src: " << cTextCurrentSource[static_cast<size_t>(getCurrentSourceStatus(i))] << '\n';
+  }
+  logger << "nDIS protect latch: " << getNdisProtectLatch() << '\n';
+  logger << "overtemp latch: " << getOverTempState() << '\n';
+  logger << "SPI SDO OV latch: " << getSdoOvLatch() << '\n';
+  logger << "temperature: " << getTemperature() << '\n';
+  logger << "Vps: " << getBatteryVoltage() << '\n';
+  logger.close();
 }
 
-template<typename tInterface>
-void L9945<tInterface>::DiagnosticsResult::appendBoolOptional(std::optional<bool> const aResult, char const * const aPresent, char const* const aMissing) noexcept {
+inline void L9945core::DiagnosticsResult::appendBoolOptional(Logger &aLogger, std::optional<bool> const aResult, char const * const aPresent, char const* const aMissing) noexcept {
   if (aResult) {
-    mParent->mInterface << aPresent << *aResult;
+    aLogger << aPresent << *aResult;
   }
   else {
-    mParent->mInterface << aMissing;
+    aLogger << aMissing;
   }
-  mParent->mInterface << '\n';
+  aLogger << '\n';
 }
 
-template<typename tInterface>
-void L9945<tInterface>::DiagnosticsResult::perform(DiagnosticsTest const aTest) {
+inline uint8_t L9945core::PulseDiagnosticsPlanner::plan(uint8_t const aEligible) noexcept {
+  for (uint32_t i = 0u; i < cChannelCount; ++i) {
+    mAge[i] += (mAge[i] < cMaxAge ? 1u : 0u);
+  }
+  uint8_t candidates = aEligible & mTracked;
+  uint8_t result = 0u;
+  for (uint32_t selected = 0u; selected < mChannelsPerTick && candidates != 0u; ++selected) {
+    uint32_t oldest = 0u;
+    uint32_t oldestAge = 0u;
+    for (uint32_t i = 0u; i < cChannelCount; ++i) {
+      if ((candidates & (1u << i)) > 0u && (mAge[i] > oldestAge || (candidates & (1u << oldest)) == 0u)) {
+        oldest = i;
+        oldestAge = mAge[i];
+      }
+      else { // nothing to do
+      }
+    }
+    candidates &= ~(1u << oldest);
+    result |= 1u << oldest;
+    mAge[oldest] = 0u;
+  }
+  return result;
+}
+
+inline void L9945core::DiagnosticsResult::perform(DiagnosticsTest const aTest) {
   mTestPerformed = aTest;
   uint32_t willTest = 0u;
-  if (aTest == DiagnosticsTest::cAuto) {
-    mParent->readAllIntoCache();
+  if (aTest == DiagnosticsTest::cAuto || aTest == DiagnosticsTest::cAutoStatusOnly) {
+    if (aTest == DiagnosticsTest::cAuto) {
+      mParent->readAllIntoCache();
+    }
+    else {
+      mParent->readStatusIntoCache();
+    }
     willTest = ((mParent->mReadCache[cCommand0] & cMask0enableDiagnostics) > 0u ? 0xffu : 0u);
     willTest &= ~(mParent->mReadCache[cCommand0] >> l9945::getRightmost1position(cMask0protectionDisable81));
   }
   else if (aTest == DiagnosticsTest::cOffPulse) {
     mParent->readAllIntoCache();
     willTest = gatherChannels(ChannelOcBlankTime::c142us, true);
-    if (willTest != 0u) {
-      mParent->setWriteDelay(cWaitForTest[static_cast<size_t>(aTest)]);
-      mParent->write(cCommand9, cFixedPatternValues[cCommand9] | willTest << l9945::getRightmost1position(cMask9diagOffPulse81));
-      mParent->mWriteCache[cCommand9] = cFixedPatternValues[cCommand9];
-    }
-    else { // nothing to do
-    }
+    issuePulses(willTest, 0u);
   }
   else if (aTest == DiagnosticsTest::cOnPulse) {
     mParent->readAllIntoCache();
     willTest = gatherChannels(ChannelOcBlankTime::c97us, false);
-    if (willTest != 0u) {
-      mParent->setWriteDelay(cWaitForTest[static_cast<size_t>(aTest)]);
-      mParent->write(cCommand9, cFixedPatternValues[cCommand9] | willTest << l9945::getRightmost1position(cMask9diagOnPulse81));
-      mParent->mWriteCache[cCommand9] = cFixedPatternValues[cCommand9];
-    }
-    else { // nothing to do
-    }
+    issuePulses(0u, willTest);
+  } 
+  else if (aTest == DiagnosticsTest::cPulse) {
+    mParent->readAllIntoCache();
+    uint32_t offPulse = gatherChannels(ChannelOcBlankTime::c142us, true);
+    uint32_t onPulse = gatherChannels(ChannelOcBlankTime::c97us, false);
+    willTest = offPulse | onPulse;
+    issuePulses(offPulse, onPulse);
   } 
   else if (aTest == DiagnosticsTest::cBist) {
     mParent->setWriteDelay(cWaitForTest[static_cast<size_t>(aTest)]);
@@ -1485,13 +3343,32 @@ void L9945<tInterface>::DiagnosticsResult::perform(DiagnosticsTest const aTest)
     mParent->readAllIntoCache(); // no separate tests, but read current statuses and latches
   }
   mReadCache = mParent->mReadCache;
-  for (uint32_t i = 0; i < cChannelCount; ++i) {
-    mChannelsDiagnosed[i] = (willTest & 1u << i) > 0u;
+  mChannelsDiagnosed = static_cast<uint8_t>(willTest);
+}
+
+inline void L9945core::DiagnosticsResult::perform(PulseDiagnosticsPlanner &aPlanner) {
+  mTestPerformed = DiagnosticsTest::cPulse;
+  mParent->readAllIntoCache();
+  uint32_t offPulse = gatherChannels(ChannelOcBlankTime::c142us, true);
+  uint32_t onPulse = gatherChannels(ChannelOcBlankTime::c97us, false);
+  uint32_t willTest = aPlanner.plan(static_cast<uint8_t>(offPulse | onPulse));
+  issuePulses(offPulse & willTest, onPulse & willTest);
+  mReadCache = mParent->mReadCache;
+  mChannelsDiagnosed = static_cast<uint8_t>(willTest);
+}
+
+inline void L9945core::DiagnosticsResult::issuePulses(uint32_t const aOffPulse, uint32_t const aOnPulse) {
+  if ((aOffPulse | aOnPulse) != 0u) {
+    mParent->setWriteDelay(cWaitForTest[static_cast<size_t>(DiagnosticsTest::cPulse)]);
+    mParent->write(cCommand9, cFixedPatternValues[cCommand9] | aOffPulse << l9945::getRightmost1position(cMask9diagOffPulse81)
+                                                             | aOnPulse << l9945::getRightmost1position(cMask9diagOnPulse81));
+    mParent->writeCache(cCommand9) = cFixedPatternValues[cCommand9];
+  }
+  else { // nothing to do
   }
 }
 
-template<typename tInterface>
-uint32_t L9945<tInterface>::DiagnosticsResult::gatherChannels(ChannelOcBlankTime const aTimeLimit, bool const aFetNow) noexcept {
+inline uint32_t L9945core::DiagnosticsResult::gatherChannels(ChannelOcBlankTime const aTimeLimit, bool const aFetNow) noexcept {
   uint32_t willTest = (mParent->getBridgeConfig(Bridge::c1) ? 0u : 0x0fu);
   willTest |= (mParent->getBridgeConfig(Bridge::c2) ? 0u : 0xf0u);
   willTest &= ((mParent->mReadCache[cCommand0] & cMask0enableDiagnostics) > 0u ? 0xffu : 0u);
@@ -1500,11 +3377,183 @@ uint32_t L9945<tInterface>::DiagnosticsResult::gatherChannels(ChannelOcBlankTime
   for (uint32_t i = 0; i < cChannelCount; ++i) {
     bool ok = (mParent->getOcBlankTime(i + 1u) < aTimeLimit);
     ok = ok && mParent->getSpiOnOut(i + 1u) == aFetNow;
-    willTest &= (ok ? 1u : 0u) << i;
+    willTest &= ~((ok ? 0u : 1u) << i);
   }
   return willTest & 0xff;
 }
 
+/// Binds an interface class like ExampleL9945interface to L9945core. It has no state of its own,
+/// only the forwarders below are instantiated for each interface type.
+template<typename tInterface>
+class L9945 final : public L9945core {
+private:
+  static constexpr float cQ15one = 32767.0f;
+
+  static Transport const cTransport;
+
+public:
+  L9945(tInterface &aInterface) noexcept
+  : L9945core(cTransport, &aInterface) {
+  }
+
+private:
+  static tInterface& getInterface(void * const aContext) noexcept {
+    return *static_cast<tInterface*>(aContext);
+  }
+
+  static void forwardDelayMs(uint32_t const aDelay) noexcept {
+    tInterface::delayMs(aDelay);
+  }
+
+  static void forwardEnableReset(void * const aContext, bool const aEnable) noexcept {
+    getInterface(aContext).enableReset(aEnable);
+  }
+
+  static void forwardEnableAll(void * const aContext, bool const aEnable) noexcept {
+    getInterface(aContext).enableAll(aEnable);
+  }
+
+  static void forwardFatalError(void * const aContext, Exception const aException) {
+    getInterface(aContext).fatalError(aException);
+  }
+
+  static SpiResult forwardTransfer(void * const aContext, uint8_t const * const aTxData, uint8_t * const aRxData, uint16_t const aSize) noexcept;
+
+  static void forwardSetPwmChannel(void * const aContext, float const aValue, uint32_t const aChannel) noexcept {
+    getInterface(aContext).setPwm(aValue, aChannel);
+  }
+
+  static void forwardSetPwmBridge(void * const aContext, float const aValue, Bridge const aBridge) noexcept {
+    getInterface(aContext).setPwm(aValue, aBridge);
+  }
+
+  static void forwardSetPwmChannelQ15(void * const aContext, int32_t const aValue, uint32_t const aChannel) noexcept;
+  static void forwardSetPwmBridgeQ15(void * const aContext, int32_t const aValue, Bridge const aBridge) noexcept;
+
+  template<typename tValue>
+  static void forwardSetPwmAll(void * const aContext, tValue const * const aValues, uint32_t const aMask) noexcept {
+    getInterface(aContext).setPwmAll(aValues, aMask);
+  }
+
+  template<typename tValue>
+  static void forwardSetPwmBridges(void * const aContext, tValue const aBridge1, tValue const aBridge2, uint32_t const aMask) noexcept {
+    getInterface(aContext).setPwmBridges(aBridge1, aBridge2, aMask);
+  }
+
+  static uint32_t forwardGetMicros(void * const aContext) noexcept {
+    return getInterface(aContext).getMicros();
+  }
+
+  static void forwardOpen(void * const aContext) noexcept {
+    getInterface(aContext).open();
+  }
+
+  static void forwardClose(void * const aContext) noexcept {
+    getInterface(aContext).close();
+  }
+
+  template<typename tValue>
+  static void forwardAppend(void * const aContext, tValue const aValue) noexcept {
+    getInterface(aContext) << aValue;
+  }
+
+  // The optional functions are nullptr if the interface does not have them.
+  template<typename tValue>
+  static constexpr void (*selectSetPwmAll() noexcept)(void * const, tValue const * const, uint32_t const);
+
+  template<typename tValue>
+  static constexpr void (*selectSetPwmBridges() noexcept)(void * const, tValue const, tValue const, uint32_t const);
+
+  static constexpr uint32_t (*selectGetMicros() noexcept)(void * const);
+};
+
+template<typename tInterface>
+L9945core::SpiResult L9945<tInterface>::forwardTransfer(void * const aContext, uint8_t const * const aTxData, uint8_t * const aRxData, uint16_t const aSize) noexcept {
+  tInterface &interface = getInterface(aContext);
+  interface.enableSpiTransfer(true);
+  SpiResult result = interface.spiTransmitReceive(aTxData, aRxData, aSize);
+  interface.enableSpiTransfer(false);
+  return result;
+}
+
+template<typename tInterface>
+void L9945<tInterface>::forwardSetPwmChannelQ15(void * const aContext, int32_t const aValue, uint32_t const aChannel) noexcept {
+  if constexpr (l9945::HasSetPwmQ15<tInterface>::value) {
+    getInterface(aContext).setPwmQ15(aValue, aChannel);
+  }
+  else {
+    getInterface(aContext).setPwm(static_cast<float>(aValue) / cQ15one, aChannel);
+  }
+}
+
+template<typename tInterface>
+void L9945<tInterface>::forwardSetPwmBridgeQ15(void * const aContext, int32_t const aValue, Bridge const aBridge) noexcept {
+  if constexpr (l9945::HasSetPwmQ15<tInterface>::value) {
+    getInterface(aContext).setPwmQ15(aValue, aBridge);
+  }
+  else {
+    getInterface(aContext).setPwm(static_cast<float>(aValue) / cQ15one, aBridge);
+  }
+}
+
+template<typename tInterface>
+template<typename tValue>
+constexpr void (*L9945<tInterface>::selectSetPwmAll() noexcept)(void * const, tValue const * const, uint32_t const) {
+  if constexpr (l9945::HasSetPwmAll<tInterface, tValue>::value) {
+    return &forwardSetPwmAll<tValue>;
+  }
+  else {
+    return nullptr;
+  }
+}
+
+template<typename tInterface>
+template<typename tValue>
+constexpr void (*L9945<tInterface>::selectSetPwmBridges() noexcept)(void * const, tValue const, tValue const, uint32_t const) {
+  if constexpr (l9945::HasSetPwmBridges<tInterface, tValue>::value) {
+    return &forwardSetPwmBridges<tValue>;
+  }
+  else {
+    return nullptr;
+  }
+}
+
+template<typename tInterface>
+constexpr uint32_t (*L9945<tInterface>::selectGetMicros() noexcept)(void * const) {
+  if constexpr (l9945::HasGetMicros<tInterface>::value) {
+    return &forwardGetMicros;
+  }
+  else {
+    return nullptr;
+  }
+}
+
+template<typename tInterface>
+L9945core::Transport const L9945<tInterface>::cTransport = {
+  &forwardDelayMs,
+  &forwardEnableReset,
+  &forwardEnableAll,
+  &forwardFatalError,
+  &forwardTransfer,
+  &forwardSetPwmChannel,
+  &forwardSetPwmBridge,
+  &forwardSetPwmChannelQ15,
+  &forwardSetPwmBridgeQ15,
+  selectSetPwmAll<float>(),
+  selectSetPwmAll<int32_t>(),
+  selectSetPwmBridges<float>(),
+  selectSetPwmBridges<int32_t>(),
+  selectGetMicros(),
+  &forwardOpen,
+  &forwardClose,
+  &forwardAppend<char const *>,
+  &forwardAppend<char>,
+  &forwardAppend<uint8_t>,
+  &forwardAppend<uint32_t>,
+  &forwardAppend<bool>,
+  &forwardAppend<float>
+};
+
 }
 
 #endif
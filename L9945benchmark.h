@@ -0,0 +1,229 @@
+
+#ifndef NOWTECH_L9945_BENCHMARK_H
+#define NOWTECH_L9945_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "L9945simulator.h"
+
+namespace nowtech {
+
+/// Transport wrapper counting the frames and bytes exchanged with the underlying transport.
+template<typename tTransport>
+class L9945countingTransport final {
+private:
+  tTransport &mTransport;
+  uint64_t    mFrameCount = 0u;
+
+public:
+  L9945countingTransport(tTransport &aTransport) noexcept : mTransport(aTransport) {
+  }
+
+  tTransport& getTransport() noexcept {
+    return mTransport;
+  }
+
+  uint64_t getFrameCount() const noexcept {
+    return mFrameCount;
+  }
+
+  uint64_t getByteCount() const noexcept {
+    return mFrameCount * sizeof(uint32_t);
+  }
+
+  void clear() noexcept {
+    mFrameCount = 0u;
+  }
+
+  L9945transportResult transfer(uint32_t const aTx, uint32_t &aRx) noexcept {
+    ++mFrameCount;
+    return mTransport.transfer(aTx, aRx);
+  }
+
+  void enableReset(bool const aEnable) noexcept {
+    mTransport.enableReset(aEnable);
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    mTransport.enableAll(aEnable);
+  }
+
+  void setInputQ15(uint32_t const aChannel, uint16_t const aDuty) noexcept {
+    mTransport.setInputQ15(aChannel, aDuty);
+  }
+};
+
+/// Measures the driver hot paths against L9945simulator. Each case prints a CSV line with
+/// host CPU ns, SPI frames, SPI bytes and simulated bus time (including delays) per operation.
+class L9945benchmark final {
+public:
+  using Transport = L9945countingTransport<L9945simulator>;
+  using Interface = L9945hostInterface<Transport>;
+  using Driver    = Interface::Driver;
+
+private:
+  L9945simulator mSimulator;
+  Transport      mTransport;
+  Interface      mInterface;
+  Driver         mDriver;
+  std::ostream  &mOut;
+  uint32_t       mIterations;
+  uint32_t       mSink = 0u;     // sum of the results of pure functions
+  uint32_t volatile mKept = 0u;  // mSink is stored here in the end, so the pure functions can't be optimized away
+
+public:
+  /// @param aOut        destination of the CSV output
+  /// @param aIterations number of calls per case
+  L9945benchmark(std::ostream &aOut, uint32_t const aIterations = 1000u)
+  : mTransport(mSimulator)
+  , mInterface(mTransport)
+  , mDriver(mInterface)
+  , mOut(aOut)
+  , mIterations(aIterations) {
+  }
+
+  Driver& getDriver() noexcept {
+    return mDriver;
+  }
+
+  L9945simulator& getSimulator() noexcept {
+    return mSimulator;
+  }
+
+  /// Runs aFunction(driver, iteration) mIterations times and prints the CSV line.
+  template<typename tFunction>
+  void measure(char const * const aName, tFunction &&aFunction);
+
+  /// Prints the CSV header and runs all the built-in cases.
+  void runAll();
+};
+
+template<typename tFunction>
+void L9945benchmark::measure(char const * const aName, tFunction &&aFunction) {
+  mTransport.clear();
+  uint64_t busStart = L9945hostClock::getMicros();
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0u; i < mIterations; ++i) {
+    aFunction(mDriver, i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double iterations = mIterations;
+  mOut << aName << ','
+       << mIterations << ','
+       << std::chrono::duration<double, std::nano>(end - start).count() / iterations << ','
+       << mTransport.getFrameCount() / iterations << ','
+       << mTransport.getByteCount() / iterations << ','
+       << (L9945hostClock::getMicros() - busStart) / iterations << '\n';
+}
+
+inline void L9945benchmark::runAll() {
+  mOut << "name,iterations,nsPerOp,framesPerOp,bytesPerOp,busMicrosPerOp\n";
+  mDriver.reset();
+  mDriver.modifyEnableDiagnostics(true);
+  for (uint32_t channel = 1u; channel <= 8u; ++channel) {
+    mDriver.modifyOutputEnable(true, channel);
+    mDriver.modifySpiInputSelect(true, channel);
+    mDriver.modifySpiOnOut(channel % 2u == 0u, channel);
+  }
+  mDriver.writeAllFromCache();
+  mSimulator.setFault(2u, L9945simulator::Fault::cOverCurrent);
+  mSimulator.setFault(3u, L9945simulator::Fault::cOpenLoad);
+
+  measure("getOcDetectTresholdMicroVolt", [this](Driver &aDriver, uint32_t const aIteration) {
+    mSink += aDriver.getOcDetectTresholdMicroVolt(aIteration % 8u + 1u);
+  });
+  measure("modifyOcDetectTresholdMicroVolt", [](Driver &aDriver, uint32_t const aIteration) {
+    aDriver.modifyOcDetectTresholdMicroVolt(500000u + aIteration, aIteration % 8u + 1u);
+  });
+  measure("getSpiOnOut", [this](Driver &aDriver, uint32_t const aIteration) {
+    mSink += aDriver.getSpiOnOut(aIteration % 8u + 1u);
+  });
+  measure("readTemperatureMilliCelsius", [this](Driver &aDriver, uint32_t) {
+    mSink += aDriver.readTemperatureMilliCelsius();
+  });
+  measure("readSpiOnOut", [this](Driver &aDriver, uint32_t const aIteration) {
+    mSink += aDriver.readSpiOnOut(aIteration % 8u + 1u);
+  });
+  measure("writeSpiOnOut", [](Driver &aDriver, uint32_t const aIteration) {
+    aDriver.writeSpiOnOut(aIteration % 2u == 0u, aIteration % 8u + 1u);
+  });
+  measure("postSpiOnOutMask", [](Driver &aDriver, uint32_t const aIteration) {
+    aDriver.postSpiOnOutMask(aIteration, 0xffu);
+  });
+  measure("setPwmQ15", [](Driver &aDriver, uint32_t const aIteration) {
+    aDriver.setPwmQ15(static_cast<int32_t>(aIteration & 0x7fffu), aIteration % 8u + 1u);
+  });
+  measure("setPwmAllQ15", [](Driver &aDriver, uint32_t const aIteration) {
+    int32_t values[8] = { 0, 1, 2, 3, 4, 5, 6, static_cast<int32_t>(aIteration & 0x7fffu) };
+    aDriver.setPwmAllQ15(values);
+  });
+  Driver::ChannelConfig configs[8];
+  measure("readChannelConfigs", [&configs](Driver &aDriver, uint32_t) {
+    aDriver.readChannelConfigs(configs);
+  });
+  // writes back the configuration just read
+  measure("writeChannelConfigs", [&configs](Driver &aDriver, uint32_t) {
+    aDriver.writeChannelConfigs(configs);
+  });
+  Driver::DeviceState state;
+  measure("readDeviceState", [&state](Driver &aDriver, uint32_t) {
+    aDriver.readDeviceState(state);
+  });
+  measure("readAllIntoCache", [](Driver &aDriver, uint32_t) {
+    aDriver.readAllIntoCache();
+  });
+  measure("writeAllFromCache", [](Driver &aDriver, uint32_t) {
+    aDriver.writeAllFromCache();
+  });
+  // after writeAllFromCache, so the configuration is verified
+  measure("readStatusIntoCache", [](Driver &aDriver, uint32_t) {
+    aDriver.readStatusIntoCache();
+  });
+  Driver::DiagnosticsResult result(&mDriver);   // caller owned, so NOWTECH_L9945_NO_DIAGNOSTICS_SNAPSHOT works as well
+  measure("diagnose(None)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cNone, result);
+  });
+  measure("diagnose(Auto)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cAuto, result);
+  });
+  measure("diagnose(AutoStatusOnly)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cAutoStatusOnly, result);
+  });
+  measure("diagnose(OffPulse)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cOffPulse, result);
+  });
+  measure("diagnose(OnPulse)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cOnPulse, result);
+  });
+  measure("diagnose(Pulse)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cPulse, result);
+  });
+  measure("diagnose(Bist)", [&result](Driver &aDriver, uint32_t) {
+    aDriver.diagnose(Driver::DiagnosticsTest::cBist, result);
+  });
+  mDriver.diagnose(Driver::DiagnosticsTest::cAuto, result);
+  measure("DiagnosticsResult::getChannelDiagnostics", [this, &result](Driver &, uint32_t const aIteration) {
+    mSink += static_cast<uint32_t>(result.getChannelDiagnostics(aIteration % 8u + 1u).value_or(Driver::ChannelDiagnostics::cNoDiagDone));
+  });
+  measure("DiagnosticsResult::getAllChannelDiagnostics", [this, &result](Driver &, uint32_t) {
+    mSink += result.getAllChannelDiagnostics().mCodes;
+  });
+  measure("DiagnosticsResult::getDeviceState", [this, &result](Driver &, uint32_t) {
+    mSink += result.getDeviceState().mChannelDiagnostics.mCodes;
+  });
+  measure("DiagnosticsResult::getCurrentSourceStatus", [this, &result](Driver &, uint32_t const aIteration) {
+    mSink += static_cast<uint32_t>(result.getCurrentSourceStatus(aIteration % 8u + 1u));
+  });
+  measure("DiagnosticsResult::log", [&result](Driver &, uint32_t) {
+    result.log();
+  });
+  measure("reset", [](Driver &aDriver, uint32_t) {
+    aDriver.reset();
+  });
+  mKept = mSink;
+}
+
+}
+
+#endif
@@ -0,0 +1,377 @@
+
+#ifndef NOWTECH_L9945_FAULT_INJECTION_H
+#define NOWTECH_L9945_FAULT_INJECTION_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include "L9945simulator.h"
+
+namespace nowtech {
+
+/// Transport wrapper injecting communication faults, either randomly at a given rate or
+/// on chosen frames. The random source is a seeded xorshift, so runs are reproducible.
+template<typename tTransport>
+class L9945faultInjectingTransport final {
+public:
+  enum class Fault : uint8_t {
+    cNone          = 0u,
+    cParityFlip    = 1u,  // one random bit of the response is flipped
+    cError         = 2u,  // the HAL reports error, the frame is not sent
+    cBusy          = 3u,  // the HAL reports busy, the frame is not sent
+    cTimeout       = 4u,  // the HAL reports timeout after waiting, the frame is not sent
+    cStuckMisoLow  = 5u,  // the frame is sent, but the response is all 0
+    cStuckMisoHigh = 6u,  // the frame is sent, but the response is all 1
+    cCount         = 7u
+  };
+
+  static constexpr uint32_t cDefaultTimeoutMicros = 10000u;
+  static constexpr uint32_t cPerMillion           = 1000000u;
+
+private:
+  tTransport                                      &mTransport;
+  std::array<uint32_t, static_cast<size_t>(Fault::cCount)> mRates;     // per million frames
+  uint64_t mFrame                = 0u;
+  uint64_t mScheduledFirst       = 0u;
+  uint64_t mScheduledEnd         = 0u;   // exclusive
+  Fault    mScheduledFault       = Fault::cNone;
+  uint32_t const mSeed;
+  uint32_t mRandom;
+  uint32_t mTimeoutMicros        = cDefaultTimeoutMicros;
+  uint32_t mInjectedCount        = 0u;
+  uint64_t mFirstInjectionMicros = 0u;
+
+public:
+  L9945faultInjectingTransport(tTransport &aTransport, uint32_t const aSeed = 1u) noexcept
+  : mTransport(aTransport)
+  , mSeed(aSeed == 0u ? 1u : aSeed)
+  , mRandom(mSeed) {
+    mRates.fill(0u);
+  }
+
+  tTransport& getTransport() noexcept {
+    return mTransport;
+  }
+
+  /// @param aRate probability of the fault in each frame, per million
+  void setRate(Fault const aFault, uint32_t const aRate) noexcept {
+    mRates[static_cast<size_t>(aFault)] = aRate;
+  }
+
+  /// Injects aFault in aCount consecutive frames starting aDistance frames from now, 0 meaning the next one.
+  void schedule(Fault const aFault, uint64_t const aDistance, uint32_t const aCount = 1u) noexcept {
+    mScheduledFault = aFault;
+    mScheduledFirst = mFrame + aDistance;
+    mScheduledEnd = mScheduledFirst + aCount;
+  }
+
+  void setTimeoutMicros(uint32_t const aMicros) noexcept {
+    mTimeoutMicros = aMicros;
+  }
+
+  void stopRandom() noexcept {
+    mRates.fill(0u);
+  }
+
+  /// Stops all injection, clears the counters and reseeds the random source, so each run is independent of the previous ones.
+  void clear() noexcept {
+    mRates.fill(0u);
+    mRandom = mSeed;
+    mScheduledFault = Fault::cNone;
+    mInjectedCount = 0u;
+    mFirstInjectionMicros = 0u;
+  }
+
+  uint64_t getFrameCount() const noexcept {
+    return mFrame;
+  }
+
+  uint32_t getInjectedCount() const noexcept {
+    return mInjectedCount;
+  }
+
+  /// Valid only if getInjectedCount() > 0.
+  uint64_t getFirstInjectionMicros() const noexcept {
+    return mFirstInjectionMicros;
+  }
+
+  L9945transportResult transfer(uint32_t const aTx, uint32_t &aRx) noexcept;
+
+  void enableReset(bool const aEnable) noexcept {
+    mTransport.enableReset(aEnable);
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    mTransport.enableAll(aEnable);
+  }
+
+  void setInputQ15(uint32_t const aChannel, uint16_t const aDuty) noexcept {
+    mTransport.setInputQ15(aChannel, aDuty);
+  }
+
+private:
+  uint32_t getRandom() noexcept {
+    mRandom ^= mRandom << 13u;
+    mRandom ^= mRandom >> 17u;
+    mRandom ^= mRandom << 5u;
+    return mRandom;
+  }
+
+  Fault chooseFault() noexcept;
+};
+
+template<typename tTransport>
+typename L9945faultInjectingTransport<tTransport>::Fault L9945faultInjectingTransport<tTransport>::chooseFault() noexcept {
+  Fault result = Fault::cNone;
+  if (mScheduledFault != Fault::cNone && mFrame >= mScheduledFirst && mFrame < mScheduledEnd) {
+    result = mScheduledFault;
+  }
+  else {
+    for (size_t i = static_cast<size_t>(Fault::cParityFlip); result == Fault::cNone && i < mRates.size(); ++i) {
+      if (mRates[i] > 0u && getRandom() % cPerMillion < mRates[i]) {
+        result = static_cast<Fault>(i);
+      }
+      else { // nothing to do
+      }
+    }
+  }
+  return result;
+}
+
+template<typename tTransport>
+L9945transportResult L9945faultInjectingTransport<tTransport>::transfer(uint32_t const aTx, uint32_t &aRx) noexcept {
+  Fault fault = chooseFault();
+  ++mFrame;
+  if (fault != Fault::cNone) {
+    if (mInjectedCount == 0u) {
+      mFirstInjectionMicros = L9945hostClock::getMicros();
+    }
+    else { // nothing to do
+    }
+    ++mInjectedCount;
+  }
+  else { // nothing to do
+  }
+  L9945transportResult result = L9945transportResult::cOk;
+  if (fault == Fault::cError) {
+    result = L9945transportResult::cError;
+  }
+  else if (fault == Fault::cBusy) {
+    result = L9945transportResult::cBusy;
+  }
+  else if (fault == Fault::cTimeout) {
+    L9945hostClock::advanceMicros(mTimeoutMicros);
+    result = L9945transportResult::cTimeout;
+  }
+  else {
+    result = mTransport.transfer(aTx, aRx);
+    if (fault == Fault::cParityFlip) {
+      aRx ^= 1u << (getRandom() % 32u);
+    }
+    else if (fault == Fault::cStuckMisoLow) {
+      aRx = 0u;
+    }
+    else if (fault == Fault::cStuckMisoHigh) {
+      aRx = 0xffffffffu;
+    }
+    else { // nothing to do
+    }
+  }
+  return result;
+}
+
+/// Recovery measurement for one scenario, all times in simulated microseconds from the first injected fault.
+struct L9945recoveryReport final {
+  char const *mName;
+  bool        mUseRecover;
+  uint32_t    mInjectedCount;
+  bool        mDetected;
+  uint64_t    mTimeToDetect;
+  bool        mUndetected;         // faults were injected, but the driver noticed none of them
+  bool        mOperational;
+  uint64_t    mTimeToOperational;
+  uint32_t    mResetCount;
+  uint32_t    mRecoverCount;
+};
+
+/// Runs fault scenarios against L9945simulator through L9945faultInjectingTransport.
+/// The application model is a control loop calling readStatusIntoCache() every tick,
+/// which detects the failure using hasSpiEverFailed() and recovers using reset(), or first trying
+/// recover() if so set. The driver is considered operational when a readAllIntoCache() after the
+/// reset succeeds, or when recover() succeeds.
+class L9945recoveryHarness final {
+public:
+  using Transport = L9945faultInjectingTransport<L9945simulator>;
+  using Fault     = Transport::Fault;
+  using Interface = L9945hostInterface<Transport>;
+  using Driver    = Interface::Driver;
+
+private:
+  static constexpr uint32_t cInjectionDistance = 5u;   // frames into the first tick
+
+  L9945simulator mSimulator;
+  Transport      mTransport;
+  Interface      mInterface;
+  Driver         mDriver;
+  uint32_t       mTickMs;
+  uint32_t       mTickLimit;
+  bool           mUseRecover = false;
+
+public:
+  /// @param aTickMs    period of the simulated control loop
+  /// @param aTickLimit a scenario is given up after this many ticks
+  L9945recoveryHarness(uint32_t const aTickMs = 1u, uint32_t const aTickLimit = 1000u, uint32_t const aSeed = 1u)
+  : mTransport(mSimulator, aSeed)
+  , mInterface(mTransport)
+  , mDriver(mInterface)
+  , mTickMs(aTickMs)
+  , mTickLimit(aTickLimit) {
+  }
+
+  Driver& getDriver() noexcept {
+    return mDriver;
+  }
+
+  Transport& getTransport() noexcept {
+    return mTransport;
+  }
+
+  /// @param aUseRecover if true, the application model tries recover() before falling back to reset()
+  void setUseRecover(bool const aUseRecover) noexcept {
+    mUseRecover = aUseRecover;
+  }
+
+  /// Injects aFault in aCount consecutive frames and measures the recovery.
+  L9945recoveryReport run(char const * const aName, Fault const aFault, uint32_t const aCount = 1u);
+
+  /// Injects faults at random with aRate per million frames for aTicks ticks, and measures the recovery from the first one.
+  L9945recoveryReport runRandom(char const * const aName, Fault const aFault, uint32_t const aRate, uint32_t const aTicks);
+
+  /// Prints a CSV header and the reports of the built-in scenarios, first using reset() only, then recover().
+  void runAll(std::ostream &aOut);
+
+  static void print(std::ostream &aOut, L9945recoveryReport const &aReport);
+
+private:
+  void start();
+  void runScenarios(std::ostream &aOut);
+  L9945recoveryReport measure(char const * const aName, uint32_t const aInjectionTicks);
+};
+
+inline L9945recoveryReport L9945recoveryHarness::run(char const * const aName, Fault const aFault, uint32_t const aCount) {
+  start();
+  mTransport.schedule(aFault, cInjectionDistance, aCount);
+  return measure(aName, 0u);
+}
+
+inline L9945recoveryReport L9945recoveryHarness::runRandom(char const * const aName, Fault const aFault, uint32_t const aRate, uint32_t const aTicks) {
+  start();
+  mTransport.setRate(aFault, aRate);
+  return measure(aName, aTicks);
+}
+
+inline void L9945recoveryHarness::start() {
+  mTransport.clear();
+  mSimulator.powerOnReset();
+  mDriver.reset();
+  mDriver.modifyEnableDiagnostics(true);
+  for (uint32_t channel = 1u; channel <= 8u; ++channel) {
+    mDriver.modifyOutputEnable(true, channel);
+  }
+  mDriver.writeAllFromCache();
+}
+
+inline L9945recoveryReport L9945recoveryHarness::measure(char const * const aName, uint32_t const aInjectionTicks) {
+  L9945recoveryReport result = { aName, mUseRecover, 0u, false, 0u, false, false, 0u, 0u, 0u };
+  for (uint32_t tick = 0u; !result.mOperational && !result.mUndetected && tick < mTickLimit; ++tick) {
+    if (tick == aInjectionTicks) {
+      mTransport.stopRandom();
+    }
+    else { // nothing to do
+    }
+    mDriver.readStatusIntoCache();
+    if (mDriver.hasSpiEverFailed()) {
+      if (!result.mDetected) {
+        result.mDetected = true;
+        result.mTimeToDetect = L9945hostClock::getMicros() - mTransport.getFirstInjectionMicros();
+      }
+      else { // nothing to do
+      }
+      bool recovered = false;
+      if (mUseRecover) {
+        ++result.mRecoverCount;
+        recovered = mDriver.recover();
+      }
+      else { // nothing to do
+      }
+      if (!recovered) {
+        mDriver.reset();
+        ++result.mResetCount;
+        mDriver.readAllIntoCache();
+      }
+      else { // nothing to do
+      }
+      if (!mDriver.hasSpiEverFailed()) {
+        result.mOperational = true;
+        result.mTimeToOperational = L9945hostClock::getMicros() - mTransport.getFirstInjectionMicros();
+      }
+      else { // nothing to do, retry in the next tick
+      }
+    }
+    else if (!result.mDetected && mTransport.getInjectedCount() > 0u && tick >= aInjectionTicks) {
+      result.mUndetected = true;     // nothing to recover from, but no recovery time either
+    }
+    else { // nothing to do
+    }
+    Interface::delayMs(mTickMs);
+  }
+  result.mInjectedCount = mTransport.getInjectedCount();
+  return result;
+}
+
+inline void L9945recoveryHarness::print(std::ostream &aOut, L9945recoveryReport const &aReport) {
+  aOut << aReport.mName << ','
+       << (aReport.mUseRecover ? "recover" : "reset") << ','
+       << aReport.mInjectedCount << ','
+       << (aReport.mDetected ? 1u : 0u) << ',';
+  if (aReport.mDetected) {
+    aOut << aReport.mTimeToDetect;
+  }
+  else { // nothing to do, the time is left empty
+  }
+  aOut << ',' << (aReport.mUndetected ? 1u : 0u) << ','
+       << (aReport.mOperational ? 1u : 0u) << ',';
+  if (aReport.mOperational) {
+    aOut << aReport.mTimeToOperational;
+  }
+  else { // nothing to do, the time is left empty
+  }
+  aOut << ','
+       << aReport.mResetCount << ','
+       << aReport.mRecoverCount << '\n';
+}
+
+inline void L9945recoveryHarness::runAll(std::ostream &aOut) {
+  aOut << "name,strategy,injected,detected,timeToDetectMicros,undetected,operational,timeToOperationalMicros,resets,recovers\n";
+  bool useRecover = mUseRecover;
+  mUseRecover = false;
+  runScenarios(aOut);
+  mUseRecover = true;
+  runScenarios(aOut);
+  mUseRecover = useRecover;
+}
+
+inline void L9945recoveryHarness::runScenarios(std::ostream &aOut) {
+  print(aOut, run("parityFlip", Fault::cParityFlip));
+  print(aOut, run("halError", Fault::cError));
+  print(aOut, run("halBusy", Fault::cBusy));
+  print(aOut, run("halTimeout", Fault::cTimeout));
+  print(aOut, run("stuckMisoLow20", Fault::cStuckMisoLow, 20u));
+  print(aOut, run("stuckMisoHigh20", Fault::cStuckMisoHigh, 20u));
+  print(aOut, run("stuckMisoLow200", Fault::cStuckMisoLow, 200u));
+  print(aOut, runRandom("parityFlip1000ppm", Fault::cParityFlip, 1000u, 100u));
+}
+
+}
+
+#endif
@@ -0,0 +1,417 @@
+
+#ifndef NOWTECH_L9945_RAMP_H
+#define NOWTECH_L9945_RAMP_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include "L9945.h"
+
+namespace nowtech {
+
+enum class L9945rampProfile : uint8_t {
+  cStep      = 0u,  // the target is output in the next tick
+  cSlew      = 1u,  // constant rate
+  cTrapezoid = 2u,  // limited rate and acceleration
+  cSCurve    = 3u   // limited rate, acceleration and jerk
+};
+
+/// Limits of a ramp in Q15 output units, where 32767 is full PWM. Only the ones needed by the profile are used.
+/// At the tick frequency f they are resolved to 2^-39 * f, f^2 and f^3 Q15 units per second, per second^2 and per
+/// second^3, respectively, so a 20 kHz tick still keeps the default jerk within 0.02 %. Smaller limits are raised to
+/// this resolution, and limits above a full scale change per tick are clamped to that. The acceleration and jerk
+/// limits are also raised if the rate or the acceleration limit would take more than 2^26 ticks to reach.
+struct L9945rampParameters final {
+  L9945rampProfile mProfile      = L9945rampProfile::cSlew;
+  uint32_t         mRate         = 32767u;   // per second
+  uint32_t         mAcceleration = 65534u;   // per second^2
+  uint32_t         mJerk         = 131068u;  // per second^3
+};
+
+/// Ramps the PWM outputs of an L9945 towards their targets, stepped by tick() from a periodic
+/// task or timer ISR. There are 10 outputs: the channels 1-8 and the bridges 1-2. Each tick
+/// costs a constant amount of integer arithmetic per output and at most one setPwmAllQ15 and
+/// one setPwmBridgesQ15 call for the outputs which have changed, and never sleeps.
+/// Targets and parameters must not be modified concurrently with tick().
+template<typename tL9945>
+class L9945rampEngine final {
+public:
+  using Bridge = typename tL9945::Bridge;
+
+  static constexpr uint32_t cChannelCount = 8u;
+  static constexpr uint32_t cOutputCount  = cChannelCount + 2u;
+
+private:
+  static constexpr uint32_t cFractionBits     = 39u;   // internal values are Q15 output units << cFractionBits
+  static constexpr int32_t  cQ15max           = 32767;
+  static constexpr int64_t  cInternalMax      = static_cast<int64_t>(cQ15max) << cFractionBits;
+  static constexpr uint32_t cDecisionBits     = 29u;   // speeds compared against the braking distance are shifted below 2^cDecisionBits
+  static constexpr uint32_t cTickFractionBits = 4u;    // durations in the braking estimates are in 1/16 ticks
+  static constexpr uint32_t cMaxTickBits      = 26u;   // maximal duration of reaching a limit
+  static constexpr uint32_t cRatioBits        = 16u;
+  static constexpr int64_t  cSaturated        = std::numeric_limits<int64_t>::max() / 8;
+
+  struct Output final {
+    L9945rampProfile mProfile = L9945rampProfile::cStep;
+    uint32_t mShift       = 0u;    // from internal units to the braking estimate units
+    int64_t mMinimum      = 0;     // internal units
+    int64_t mPosition     = 0;
+    int64_t mVelocity     = 0;     // per tick
+    int64_t mAcceleration = 0;     // per tick^2, only for cSCurve
+    int64_t mTarget       = 0;
+    int64_t mRate         = 0;     // limits per tick, tick^2 and tick^3
+    int64_t mAccelLimit   = 0;
+    int64_t mJerk         = 0;
+    int32_t mLastOutput   = 0;     // Q15
+  };
+
+  tL9945                              &mDriver;
+  uint32_t const                       mTickHz;
+  std::array<Output, cOutputCount>     mOutputs;
+  std::array<int32_t, cChannelCount>   mChannelValues = {};
+
+public:
+  /// @param aTickHz frequency of the tick() calls, at most 2 MHz
+  L9945rampEngine(tL9945 &aDriver, uint32_t const aTickHz) noexcept
+  : mDriver(aDriver)
+  , mTickHz(aTickHz) {
+    for (uint32_t i = cChannelCount; i < cOutputCount; ++i) {
+      mOutputs[i].mMinimum = -cInternalMax;
+    }
+  }
+
+  /// @param aChannel channel number from 1 to 8, inclusive.
+  void setParameters(L9945rampParameters const &aParameters, uint32_t const aChannel) noexcept {
+    if (aChannel - 1u < cChannelCount) {
+      setParameters(mOutputs[aChannel - 1u], aParameters);
+    }
+    else { // nothing to do
+    }
+  }
+
+  void setParameters(L9945rampParameters const &aParameters, Bridge const aBridge) noexcept {
+    setParameters(mOutputs[bridge2index(aBridge)], aParameters);
+  }
+
+  /// @param aTarget Q15: 0 closed, 32767 full time open
+  void setTarget(int32_t const aTarget, uint32_t const aChannel) noexcept {
+    if (aChannel - 1u < cChannelCount) {
+      setTarget(mOutputs[aChannel - 1u], aTarget);
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// @param aTarget Q15: -32767 full speed reverse, 0 stop, 32767 full speed forward
+  void setTarget(int32_t const aTarget, Bridge const aBridge) noexcept {
+    setTarget(mOutputs[bridge2index(aBridge)], aTarget);
+  }
+
+  /// Sets the output and the target at once, stopping any ramp in progress. Takes effect in the next tick.
+  void jump(int32_t const aValue, uint32_t const aChannel) noexcept {
+    if (aChannel - 1u < cChannelCount) {
+      jump(mOutputs[aChannel - 1u], aValue);
+    }
+    else { // nothing to do
+    }
+  }
+
+  void jump(int32_t const aValue, Bridge const aBridge) noexcept {
+    jump(mOutputs[bridge2index(aBridge)], aValue);
+  }
+
+  /// @returns the last output value in Q15.
+  int32_t getValue(uint32_t const aChannel) const noexcept {
+    return aChannel - 1u < cChannelCount ? mOutputs[aChannel - 1u].mLastOutput : 0;
+  }
+
+  int32_t getValue(Bridge const aBridge) const noexcept {
+    return mOutputs[bridge2index(aBridge)].mLastOutput;
+  }
+
+  /// @returns true if no output is ramping.
+  bool isSettled() const noexcept {
+    bool result = true;
+    for (auto const &output : mOutputs) {
+      result = result && output.mPosition == output.mTarget && output.mVelocity == 0;
+    }
+    return result;
+  }
+
+  /// Advances all the ramps by one tick and sends the changed outputs to the driver.
+  void tick() noexcept;
+
+private:
+  static uint32_t bridge2index(Bridge const aBridge) noexcept {
+    return cChannelCount + (aBridge == Bridge::c1 ? 0u : 1u);
+  }
+
+  /// @returns (aValue << cFractionBits) / aDivisor between 1 and cInternalMax, by long division, because the shifted value would overflow.
+  static int64_t perTick(uint64_t const aValue, uint64_t const aDivisor) noexcept {
+    uint64_t quotient = std::min<uint64_t>(aValue / aDivisor, static_cast<uint64_t>(cQ15max));
+    uint64_t remainder = (quotient < static_cast<uint64_t>(cQ15max) ? aValue % aDivisor : 0u);
+    for (uint32_t i = 0u; i < cFractionBits; ++i) {
+      remainder <<= 1u;
+      quotient <<= 1u;
+      if (remainder >= aDivisor) {
+        remainder -= aDivisor;
+        ++quotient;
+      }
+      else { // nothing to do
+      }
+    }
+    return std::max<int64_t>(static_cast<int64_t>(quotient), 1);
+  }
+
+  void setParameters(Output &aOutput, L9945rampParameters const &aParameters) noexcept {
+    uint64_t hz = mTickHz;
+    aOutput.mProfile = aParameters.mProfile;
+    aOutput.mRate = perTick(aParameters.mRate, hz);
+    aOutput.mAccelLimit = perTick(aParameters.mAcceleration, hz * hz);
+    aOutput.mJerk = perTick(aParameters.mJerk, hz * hz * hz);
+    aOutput.mAccelLimit = std::max(aOutput.mAccelLimit, aOutput.mRate >> cMaxTickBits);
+    aOutput.mJerk = std::max(aOutput.mJerk, aOutput.mAccelLimit >> cMaxTickBits);
+    aOutput.mShift = 0u;
+    while ((aOutput.mRate >> aOutput.mShift) >= (static_cast<int64_t>(1) << cDecisionBits)) {
+      ++aOutput.mShift;
+    }
+  }
+
+  void setTarget(Output &aOutput, int32_t const aTarget) noexcept {
+    aOutput.mTarget = static_cast<int64_t>(std::min(std::max(aTarget, static_cast<int32_t>(aOutput.mMinimum >> cFractionBits)), cQ15max)) << cFractionBits;
+  }
+
+  void jump(Output &aOutput, int32_t const aValue) noexcept {
+    setTarget(aOutput, aValue);
+    aOutput.mPosition = aOutput.mTarget;
+    aOutput.mVelocity = 0;
+    aOutput.mAcceleration = 0;
+  }
+
+  /// Integer square root in a constant number of steps.
+  static int64_t squareRoot(int64_t const aValue) noexcept {
+    uint64_t remainder = static_cast<uint64_t>(aValue);
+    uint64_t result = 0u;
+    for (uint64_t bit = 1ull << 62u; bit > 0u; bit >>= 2u) {
+      if (remainder >= result + bit) {
+        remainder -= result + bit;
+        result = (result >> 1u) + bit;
+      }
+      else {
+        result >>= 1u;
+      }
+    }
+    return static_cast<int64_t>(result);
+  }
+
+  /// @returns aNumerator / aDenominator in 1/16 ticks, where aNumerator < 2^58.
+  static int64_t getTicks(int64_t const aNumerator, int64_t const aDenominator) noexcept {
+    return (aNumerator << cTickFractionBits) / aDenominator;
+  }
+
+  /// @returns (aValue * aFactor) >> aFractionBits for non-negative arguments, saturated to avoid overflow.
+  static int64_t multiply(int64_t const aValue, int64_t const aFactor, uint32_t const aFractionBits) noexcept {
+    return (aValue > 0 && aFactor > cSaturated / aValue ? cSaturated : aValue * aFactor) >> aFractionBits;
+  }
+
+  /// @returns the distance covered at aSpeed in the braking estimate units during aTicks in 1/16 ticks.
+  static int64_t getTravel(int64_t const aSpeed, int64_t const aTicks) noexcept {
+    return multiply(aSpeed, aTicks, cTickFractionBits);
+  }
+
+  static int64_t getSCurveBraking(Output const &aOutput, int64_t const aSpeed, int64_t const aAcceleration) noexcept;
+
+  /// @returns the distance left in the braking estimate units when releasing the brake after the acceleration aActual becomes aNext in this tick.
+  static int64_t getSCurveGap(Output const &aOutput, int64_t const aDistance, int64_t const aSpeed, int64_t const aActual, int64_t const aNext) noexcept {
+    int64_t speed = aSpeed + (aActual + aNext) / 2;
+    return ((aDistance - (aSpeed + speed) / 2) >> aOutput.mShift) - (speed > 0 ? getSCurveBraking(aOutput, speed, aNext) : 0);
+  }
+
+  static void step(Output &aOutput) noexcept;
+};
+
+/// @returns the distance needed to stop from aSpeed > 0 when the acceleration, now aAcceleration, first returns
+/// to 0 along the jerk limit, and then a full jerk limited braking follows if needed. While braking, this is the
+/// distance of releasing the brake now, so the ramp ends at the target instead of crawling towards it.
+/// The speeds and the result are internal units >> aOutput.mShift, while the durations come from the full precision values.
+template<typename tL9945>
+int64_t L9945rampEngine<tL9945>::getSCurveBraking(Output const &aOutput, int64_t const aSpeed, int64_t const aAcceleration) noexcept {
+  int64_t magnitude = std::min<int64_t>(std::abs(aAcceleration), aOutput.mAccelLimit);
+  int64_t speed = aSpeed >> aOutput.mShift;
+  int64_t rampTicks = getTicks(magnitude, aOutput.mJerk);
+  int64_t rampSpeed = std::min<int64_t>(getTravel(magnitude >> aOutput.mShift, rampTicks) / 2, aOutput.mRate >> aOutput.mShift);   // speed change while the acceleration returns to 0
+  int64_t result;
+  int64_t remaining;          // speed when the acceleration is back at 0
+  if (aAcceleration > 0) {
+    remaining = speed + rampSpeed;
+    result = getTravel(speed, rampTicks) + getTravel(rampSpeed, rampTicks) * 2 / 3;
+  }
+  else if (speed > rampSpeed || magnitude == 0) {
+    remaining = speed - rampSpeed;
+    result = getTravel(speed, rampTicks) - getTravel(rampSpeed, rampTicks) * 2 / 3;
+  }
+  else {                      // stops before the brake is fully released, after stopTicks = rampTicks - sqrt(rampTicks^2 - 2 * speed / jerk)
+    remaining = 0;
+    int64_t stopTicks = rampTicks - squareRoot(std::max<int64_t>(rampTicks * rampTicks - (getTicks(2 * aSpeed, aOutput.mJerk) << cTickFractionBits), 0));
+    int64_t decelerating = getTravel(magnitude >> aOutput.mShift, stopTicks);                             // magnitude * stopTicks
+    int64_t released = multiply(decelerating, (stopTicks << cRatioBits) / std::max<int64_t>(rampTicks, 1), cRatioBits);   // jerk * stopTicks^2
+    result = getTravel(speed - decelerating / 2 + released / 6, stopTicks);
+  }
+  if (remaining > 0) {
+    int64_t fullRemaining = remaining << aOutput.mShift;
+    int64_t limitTicks = getTicks(aOutput.mAccelLimit, aOutput.mJerk);
+    int64_t stopTicks = getTicks(fullRemaining, aOutput.mAccelLimit);
+    if (stopTicks >= limitTicks) {
+      result += (getTravel(remaining, stopTicks) + getTravel(remaining, limitTicks)) / 2;
+    }
+    else {                    // the deceleration limit is not reached, so it takes 2 * sqrt(remaining / jerk)
+      result += getTravel(remaining, squareRoot(getTicks(fullRemaining, aOutput.mJerk) << cTickFractionBits));
+    }
+  }
+  else { // nothing to do
+  }
+  return result;
+}
+
+template<typename tL9945>
+void L9945rampEngine<tL9945>::step(Output &aOutput) noexcept {
+  int64_t error = aOutput.mTarget - aOutput.mPosition;
+  int64_t direction = (error > 0 ? 1 : (error < 0 ? -1 : 0));
+  int64_t distance = error * direction;
+  int64_t travel;
+  if (aOutput.mProfile == L9945rampProfile::cStep) {
+    aOutput.mVelocity = error;
+    travel = aOutput.mVelocity;
+  }
+  else if (aOutput.mProfile == L9945rampProfile::cSlew) {
+    aOutput.mVelocity = std::min<int64_t>(distance, aOutput.mRate) * direction;
+    travel = aOutput.mVelocity;
+  }
+  else {
+    int64_t speed = aOutput.mVelocity * direction;   // negative if moving away from the target
+    int64_t accelLimit = aOutput.mAccelLimit;
+    int64_t actual = aOutput.mAcceleration * direction;
+    int64_t braking = 0;
+    if (speed <= 0) { // nothing to do
+    }
+    else if (aOutput.mProfile != L9945rampProfile::cSCurve) {
+      braking = getTravel(speed >> aOutput.mShift, getTicks(speed, accelLimit)) / 2 + (speed >> aOutput.mShift);   // starts braking one tick earlier, so never late
+    }
+    else if (actual < 0) {
+      braking = getSCurveBraking(aOutput, speed, actual);
+    }
+    else {
+      int64_t next = std::min<int64_t>(actual + aOutput.mJerk, accelLimit);
+      int64_t ahead = speed + (actual + next) / 2;
+      braking = getSCurveBraking(aOutput, ahead, next) + ((speed + ahead) / 2 >> aOutput.mShift);   // decides on the state of the next tick, so never late
+    }
+    bool brake = braking >= (distance >> aOutput.mShift);
+    int64_t rate = aOutput.mRate;
+    if (aOutput.mProfile == L9945rampProfile::cSCurve && actual > 0) {
+      rate -= multiply(actual, getTicks(actual, aOutput.mJerk), cTickFractionBits) / 2;   // reaches the rate when the acceleration is back at 0
+    }
+    else { // nothing to do
+    }
+    int64_t acceleration = (speed < 0 || (speed < rate && !brake) ? accelLimit : (speed > 0 && brake ? -accelLimit : 0));
+    int64_t change = acceleration;
+    if (aOutput.mProfile == L9945rampProfile::cSCurve) {
+      if (speed > 0 && actual < 0 && !brake) {   // releasing from (2/3) speed^2 / distance at the constant jerk landing^2 / (2 * speed) stops at the target
+        int64_t landing = 2 * multiply(speed >> aOutput.mShift, speed >> aOutput.mShift, 0u) / std::max<int64_t>(3 * (distance >> aOutput.mShift), 1);
+        landing = std::max<int64_t>(std::min<int64_t>(multiply(landing, static_cast<int64_t>(1) << aOutput.mShift, 0u), accelLimit), 1);
+        if (getTicks(2 * speed, landing) * 8 <= getTicks(landing, aOutput.mJerk) * 9) {
+          acceleration = -landing;
+        }
+        else { // a much gentler landing would be slow, so it releases at the full jerk and brakes again later
+        }
+      }
+      else { // nothing to do
+      }
+      if (speed > 0 && brake) {   // the release starts between two ticks, so that tick is interpolated
+        int64_t braked = std::max<int64_t>(actual - aOutput.mJerk, -accelLimit);
+        int64_t brakedGap = getSCurveGap(aOutput, distance, speed, actual, braked);
+        if (brakedGap > 0) {
+          int64_t released = std::min<int64_t>(actual + aOutput.mJerk, accelLimit);
+          int64_t releasedGap = getSCurveGap(aOutput, distance, speed, actual, released);
+          acceleration = (releasedGap < 0 ? braked + multiply(released - braked, (brakedGap << cRatioBits) / (brakedGap - releasedGap), cRatioBits) : released);
+        }
+        else { // nothing to do
+        }
+      }
+      else { // nothing to do
+      }
+      int64_t jerk = aOutput.mJerk;
+      if (speed > 0 && actual < 0 && acceleration > actual) {   // the rounding of the ticks may need a slightly faster release to stop at the target
+        jerk = std::min<int64_t>(std::max<int64_t>(jerk, (-actual << cTickFractionBits) / std::max<int64_t>(getTicks(2 * speed, -actual), 1)), jerk + jerk / 8);
+      }
+      else { // nothing to do
+      }
+      acceleration = (acceleration > actual ? std::min<int64_t>(actual + jerk, acceleration) : std::max<int64_t>(actual - jerk, acceleration));
+      aOutput.mAcceleration = acceleration * direction;
+      change = (actual + acceleration) / 2;   // the mean acceleration of the tick
+    }
+    else if (speed > 0 && brake) {
+      int64_t needed = multiply(speed >> aOutput.mShift, speed >> aOutput.mShift, 0u) / std::max<int64_t>(2 * (distance >> aOutput.mShift), 1);
+      change = acceleration = -std::min<int64_t>(needed << aOutput.mShift, accelLimit);   // brakes from one tick earlier so that it stops at the target
+    }
+    else { // nothing to do
+    }
+    speed = std::min<int64_t>(speed + change, aOutput.mRate);
+    travel = (aOutput.mVelocity + speed * direction) / 2;   // the mean velocity of the tick, as the braking estimates assume
+    if (distance < (static_cast<int64_t>(1) << cFractionBits)) {
+      travel = error;         // the rest is below the output resolution
+    }
+    else if (speed <= 0 && speed > -accelLimit) {
+      speed = std::min<int64_t>(accelLimit, distance);   // avoid stalling short of the target
+      travel = speed * direction;
+    }
+    else { // nothing to do
+    }
+    aOutput.mVelocity = speed * direction;
+  }
+  if (travel * direction >= distance) {
+    aOutput.mPosition = aOutput.mTarget;
+    aOutput.mVelocity = 0;
+    aOutput.mAcceleration = 0;
+  }
+  else {
+    aOutput.mPosition = std::min<int64_t>(std::max<int64_t>(aOutput.mPosition + travel, aOutput.mMinimum), cInternalMax);
+  }
+}
+
+template<typename tL9945>
+void L9945rampEngine<tL9945>::tick() noexcept {
+  uint32_t changedChannels = 0u;
+  bool changedBridges = false;
+  for (uint32_t i = 0u; i < cOutputCount; ++i) {
+    Output &output = mOutputs[i];
+    step(output);
+    int32_t value = static_cast<int32_t>(output.mPosition / (static_cast<int64_t>(1) << cFractionBits));
+    if (value != output.mLastOutput) {
+      output.mLastOutput = value;
+      if (i < cChannelCount) {
+        mChannelValues[i] = value;
+        changedChannels |= 1u << i;
+      }
+      else {
+        changedBridges = true;
+      }
+    }
+    else { // nothing to do
+    }
+  }
+  if (changedChannels > 0u) {
+    mDriver.setPwmAllQ15(mChannelValues.data(), changedChannels);
+  }
+  else { // nothing to do
+  }
+  if (changedBridges) {
+    mDriver.setPwmBridgesQ15(mOutputs[cChannelCount].mLastOutput, mOutputs[cChannelCount + 1u].mLastOutput);
+  }
+  else { // nothing to do
+  }
+}
+
+}
+
+#endif
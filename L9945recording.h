@@ -0,0 +1,373 @@
+
+#ifndef NOWTECH_L9945_RECORDING_H
+#define NOWTECH_L9945_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include "L9945simulator.h"
+
+namespace nowtech {
+
+namespace l9945 {
+
+/// Binary session format: cRecordingMagic followed by records starting with a tag byte.
+/// The low nibble of the tag is a parameter:
+///   cTagTransfer | SpiResult, size byte, size TX bytes, size RX bytes
+///   cTagSelect   | enable
+///   cTagReset    | enable
+///   cTagEnable   | enable
+///   cTagFatal    | Exception
+///   cTagDelay,   delay in ms as little-endian base-128 varint, only for nonzero delays
+constexpr uint8_t cRecordingMagic[] = { 'L', '9', '4', '5', 'R', 1u };
+constexpr uint8_t cTagTransfer      = 0x10u;
+constexpr uint8_t cTagSelect        = 0x20u;
+constexpr uint8_t cTagReset         = 0x30u;
+constexpr uint8_t cTagEnable        = 0x40u;
+constexpr uint8_t cTagFatal         = 0x50u;
+constexpr uint8_t cTagDelay         = 0x60u;
+constexpr uint8_t cMaskTag          = 0xf0u;
+constexpr uint8_t cMaskTagParameter = 0x0fu;
+
+}
+
+/// Sink of L9945recordingInterface writing to a stream, for example an std::ofstream opened in binary mode.
+/// A sink needs only a void write(uint8_t const* const aData, size_t const aSize) noexcept method,
+/// so on target a RAM or flash buffer can be used instead.
+class L9945ostreamSink final {
+private:
+  std::ostream &mOut;
+
+public:
+  L9945ostreamSink(std::ostream &aOut) noexcept : mOut(aOut) {
+  }
+
+  void write(uint8_t const* const aData, size_t const aSize) noexcept {
+    mOut.write(reinterpret_cast<char const*>(aData), aSize);
+  }
+};
+
+/// tInterface wrapper recording the SPI session of the wrapped interface into tSink.
+/// Only one instance may exist at a time, because delayMs is static.
+template<typename tInterface, typename tSink>
+class L9945recordingInterface final {
+public:
+  using Driver        = L9945<L9945recordingInterface<tInterface, tSink>>;
+  using WrappedDriver = L9945<tInterface>;
+
+private:
+  static inline L9945recordingInterface *sActive = nullptr;
+
+  tInterface &mInterface;
+  tSink      &mSink;
+
+public:
+  L9945recordingInterface(tInterface &aInterface, tSink &aSink) noexcept
+  : mInterface(aInterface)
+  , mSink(aSink) {
+    sActive = this;
+    mSink.write(l9945::cRecordingMagic, sizeof(l9945::cRecordingMagic));
+  }
+
+  ~L9945recordingInterface() noexcept {
+    sActive = nullptr;
+  }
+
+  static void delayMs(uint32_t const aDelay) noexcept {
+    tInterface::delayMs(aDelay);
+    if (sActive != nullptr && aDelay > 0u) {
+      uint8_t buffer[6u] = { l9945::cTagDelay };
+      size_t size = 1u;
+      for (uint32_t rest = aDelay; rest > 0u; rest >>= 7u) {
+        buffer[size] = static_cast<uint8_t>(rest & 0x7fu) | (rest > 0x7fu ? 0x80u : 0u);
+        ++size;
+      }
+      sActive->mSink.write(buffer, size);
+    }
+    else { // nothing to do
+    }
+  }
+
+  void enableReset(bool const aEnable) noexcept {
+    mInterface.enableReset(aEnable);
+    writeTag(l9945::cTagReset | (aEnable ? 1u : 0u));
+  }
+
+  void enableSpiTransfer(bool const aEnable) noexcept {
+    mInterface.enableSpiTransfer(aEnable);
+    writeTag(l9945::cTagSelect | (aEnable ? 1u : 0u));
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    mInterface.enableAll(aEnable);
+    writeTag(l9945::cTagEnable | (aEnable ? 1u : 0u));
+  }
+
+  void fatalError(typename Driver::Exception const aException) {
+    writeTag(l9945::cTagFatal | static_cast<uint8_t>(aException));
+    mInterface.fatalError(static_cast<typename WrappedDriver::Exception>(aException));
+  }
+
+  typename Driver::SpiResult spiTransmitReceive(uint8_t const* const aTxData, uint8_t* const aRxData, uint16_t const aSize) noexcept {
+    auto result = mInterface.spiTransmitReceive(aTxData, aRxData, aSize);
+    uint8_t header[2u] = { static_cast<uint8_t>(l9945::cTagTransfer | static_cast<uint8_t>(result)), static_cast<uint8_t>(aSize) };
+    mSink.write(header, sizeof(header));
+    mSink.write(aTxData, aSize);
+    mSink.write(aRxData, aSize);
+    return static_cast<typename Driver::SpiResult>(result);
+  }
+
+  void setPwm(float const aValue, typename Driver::Bridge const aBridge) noexcept {
+    mInterface.setPwm(aValue, static_cast<typename WrappedDriver::Bridge>(aBridge));
+  }
+
+  void setPwm(float const aValue, uint32_t const aChannel) noexcept {
+    mInterface.setPwm(aValue, aChannel);
+  }
+
+  void setPwmQ15(int32_t const aValue, typename Driver::Bridge const aBridge) noexcept {
+    mInterface.setPwmQ15(aValue, static_cast<typename WrappedDriver::Bridge>(aBridge));
+  }
+
+  void setPwmQ15(int32_t const aValue, uint32_t const aChannel) noexcept {
+    mInterface.setPwmQ15(aValue, aChannel);
+  }
+
+  uint32_t getMicros() noexcept {
+    if constexpr (l9945::HasGetMicros<tInterface>::value) {
+      return mInterface.getMicros();
+    }
+    else {
+      return 0u;
+    }
+  }
+
+  void open() noexcept {
+    mInterface.open();
+  }
+
+  template<typename ToAppend>
+  L9945recordingInterface& operator<<(ToAppend aWhat) noexcept {
+    mInterface << aWhat;
+    return *this;
+  }
+
+  void close() noexcept {
+    mInterface.close();
+  }
+
+private:
+  void writeTag(uint8_t const aTag) noexcept {
+    mSink.write(&aTag, 1u);
+  }
+};
+
+/// tInterface replaying a session recorded by L9945recordingInterface. Each transfer returns
+/// the recorded response and result, delays advance L9945hostClock by the recorded time.
+/// Any difference between the calls of the driver and the recording is counted as a divergence,
+/// and the replay goes on. Only one instance may exist at a time, because delayMs is static.
+class L9945replayInterface final {
+public:
+  using Driver = L9945<L9945replayInterface>;
+
+private:
+  static inline L9945replayInterface *sActive = nullptr;
+
+  uint8_t const *mData;
+  size_t         mSize;
+  size_t         mPosition;
+  uint32_t       mDivergenceCount  = 0u;
+  size_t         mFirstDivergence  = 0u;
+  uint32_t       mFatalErrorCount  = 0u;
+  uint32_t       mTransferCount    = 0u;
+  std::ostream  *mLog;
+
+public:
+  /// @param aData the whole recording including the magic, must outlive the instance
+  /// @param aLog  destination of the diagnostics log, nothing is logged if nullptr
+  L9945replayInterface(uint8_t const * const aData, size_t const aSize, std::ostream * const aLog = nullptr) noexcept
+  : mData(aData)
+  , mSize(aSize)
+  , mPosition(sizeof(l9945::cRecordingMagic))
+  , mLog(aLog) {
+    sActive = this;
+    bool valid = aSize >= sizeof(l9945::cRecordingMagic);
+    for (size_t i = 0u; valid && i < sizeof(l9945::cRecordingMagic); ++i) {
+      valid = aData[i] == l9945::cRecordingMagic[i];
+    }
+    if (!valid) {
+      mPosition = mSize;
+      diverge();
+    }
+    else { // nothing to do
+    }
+  }
+
+  ~L9945replayInterface() noexcept {
+    sActive = nullptr;
+  }
+
+  bool isFinished() const noexcept {
+    return mPosition >= mSize;
+  }
+
+  uint32_t getDivergenceCount() const noexcept {
+    return mDivergenceCount;
+  }
+
+  /// Offset in the recording where the first divergence was found, valid if getDivergenceCount() > 0.
+  size_t getFirstDivergence() const noexcept {
+    return mFirstDivergence;
+  }
+
+  uint32_t getFatalErrorCount() const noexcept {
+    return mFatalErrorCount;
+  }
+
+  uint32_t getTransferCount() const noexcept {
+    return mTransferCount;
+  }
+
+  static void delayMs(uint32_t const aDelay) noexcept {
+    L9945hostClock::advanceMicros(aDelay * 1000ull);
+    if (sActive != nullptr && aDelay > 0u) {
+      uint32_t recorded = 0u;
+      if (sActive->expect(l9945::cTagDelay, 0u)) {
+        uint32_t shift = 0u;
+        bool more = true;
+        while (more && sActive->mPosition < sActive->mSize && shift < 32u) {
+          uint8_t byte = sActive->mData[sActive->mPosition];
+          ++sActive->mPosition;
+          recorded |= static_cast<uint32_t>(byte & 0x7fu) << shift;
+          shift += 7u;
+          more = (byte & 0x80u) > 0u;
+        }
+      }
+      else { // nothing to do
+      }
+      if (recorded != aDelay) {
+        sActive->diverge();
+      }
+      else { // nothing to do
+      }
+    }
+    else { // nothing to do
+    }
+  }
+
+  void enableReset(bool const aEnable) noexcept {
+    expect(l9945::cTagReset, aEnable ? 1u : 0u);
+  }
+
+  void enableSpiTransfer(bool const aEnable) noexcept {
+    expect(l9945::cTagSelect, aEnable ? 1u : 0u);
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    expect(l9945::cTagEnable, aEnable ? 1u : 0u);
+  }
+
+  void fatalError(Driver::Exception const aException) noexcept {
+    ++mFatalErrorCount;
+    expect(l9945::cTagFatal, static_cast<uint8_t>(aException));
+  }
+
+  Driver::SpiResult spiTransmitReceive(uint8_t const* const aTxData, uint8_t* const aRxData, uint16_t const aSize) noexcept;
+
+  void setPwm(float const, Driver::Bridge const) noexcept {
+  }
+
+  void setPwm(float const, uint32_t const) noexcept {
+  }
+
+  void setPwmQ15(int32_t const, Driver::Bridge const) noexcept {
+  }
+
+  void setPwmQ15(int32_t const, uint32_t const) noexcept {
+  }
+
+  uint32_t getMicros() noexcept {
+    return static_cast<uint32_t>(L9945hostClock::getMicros());
+  }
+
+  void open() noexcept {
+  }
+
+  template<typename ToAppend>
+  L9945replayInterface& operator<<(ToAppend aWhat) noexcept {
+    if (mLog != nullptr) {
+      *mLog << aWhat;
+    }
+    else { // nothing to do
+    }
+    return *this;
+  }
+
+  void close() noexcept {
+  }
+
+private:
+  void diverge() noexcept {
+    if (mDivergenceCount == 0u) {
+      mFirstDivergence = mPosition;
+    }
+    else { // nothing to do
+    }
+    ++mDivergenceCount;
+  }
+
+  /// Consumes the next record if it has the tag, otherwise leaves it in place.
+  /// @returns true if the tag matched, and puts its parameter in aParameter.
+  bool expect(uint8_t const aTag, uint8_t const aParameter) noexcept {
+    bool result = mPosition < mSize && (mData[mPosition] & l9945::cMaskTag) == aTag;
+    if (result) {
+      if ((mData[mPosition] & l9945::cMaskTagParameter) != aParameter && aTag != l9945::cTagTransfer) {
+        diverge();
+      }
+      else { // nothing to do
+      }
+      ++mPosition;
+    }
+    else {
+      diverge();
+    }
+    return result;
+  }
+};
+
+inline L9945replayInterface::Driver::SpiResult L9945replayInterface::spiTransmitReceive(uint8_t const* const aTxData, uint8_t* const aRxData, uint16_t const aSize) noexcept {
+  ++mTransferCount;
+  Driver::SpiResult result = Driver::SpiResult::cError;
+  size_t position = mPosition;
+  if (expect(l9945::cTagTransfer, 0u) && mPosition < mSize) {
+    result = static_cast<Driver::SpiResult>(mData[position] & l9945::cMaskTagParameter);
+    size_t size = mData[mPosition];
+    ++mPosition;
+    if (size == aSize && mPosition + 2u * size <= mSize) {
+      bool same = true;
+      for (size_t i = 0u; i < size; ++i) {
+        same = same && mData[mPosition + i] == aTxData[i];
+        aRxData[i] = mData[mPosition + size + i];
+      }
+      if (!same) {
+        diverge();
+      }
+      else { // nothing to do
+      }
+      mPosition += 2u * size;
+    }
+    else {
+      mPosition = mSize;
+      diverge();
+      result = Driver::SpiResult::cError;
+    }
+  }
+  else {
+    result = Driver::SpiResult::cError;
+  }
+  return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,647 @@
+
+#ifndef NOWTECH_L9945_SIMULATOR_H
+#define NOWTECH_L9945_SIMULATOR_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include "L9945.h"
+
+namespace nowtech {
+
+/// Simulated time shared by all the host-side models. It only advances when told,
+/// so runs are deterministic regardless of the host speed.
+class L9945hostClock final {
+private:
+  static inline uint64_t sMicros = 0u;
+
+public:
+  static uint64_t getMicros() noexcept {
+    return sMicros;
+  }
+
+  static void advanceMicros(uint64_t const aMicros) noexcept {
+    sMicros += aMicros;
+  }
+};
+
+/// Result of a transport frame exchange, values match L9945::SpiResult.
+enum class L9945transportResult : uint32_t {
+  cOk      = 0x00U,
+  cError   = 0x01U,
+  cBusy    = 0x02U,
+  cTimeout = 0x03U
+};
+
+/// Register-level software model of the L9945. It is independent of the driver
+/// on purpose, so it uses its own constants taken from the datasheet.
+/// Frames are processed as on the chip: the response to a frame is shifted out during the
+/// next one, frames with parity error, invalid command or wrong fixed pattern are ignored.
+/// Time dependent behavior (pulse diagnostics, BIST, comm check) uses L9945hostClock.
+/// Implements the transport concept of L9945hostInterface.
+class L9945simulator final {
+public:
+  enum class Fault : uint8_t {
+    cNone           = 0u,
+    cOpenLoad       = 1u,
+    cShortToGround  = 2u,
+    cShortToBattery = 3u,
+    cOverCurrent    = 4u
+  };
+
+  static constexpr uint32_t cRegisterCount              = 14u;
+  static constexpr uint32_t cChannelCount               =  8u;
+  static constexpr uint32_t cPulseTestMicros            = 1000u;
+  static constexpr uint32_t cBistMicros                 = 3000u;
+  static constexpr uint32_t cDefaultCommCheckMicros     = 16000u;
+  static constexpr uint32_t cOverTemperatureAdc         = 857u;   // 175 C
+  static constexpr uint32_t cVpsUndervoltageAdc         = 94u;    // 4.5 V
+
+private:
+  static constexpr uint32_t cCommand0                   =  0u;
+  static constexpr uint32_t cCommand9                   =  9u;
+  static constexpr uint32_t cCommand10                  = 10u;
+  static constexpr uint32_t cCommand13                  = 13u;
+  static constexpr uint32_t cNoCommand                  = 0x0fu;
+
+  static constexpr uint32_t cMaskRead                   = 0x01u << 27u;
+  static constexpr uint32_t cMaskData                   = 0x07fffffeu;
+  static constexpr uint32_t cMaskEnableDiagnostics      = 0x01u << 25u;
+  static constexpr uint32_t cShiftSpiInputSelect        = 17u;
+  static constexpr uint32_t cShiftProtectionDisable     =  9u;
+  static constexpr uint32_t cShiftSpiOnOut              =  1u;
+  static constexpr uint32_t cMaskBridgeConfig           = 0x01u << 26u;   // commands 4 and 8
+  static constexpr uint32_t cMaskCurrentLimitEnable     = 0x01u << 26u;   // commands 3 and 7
+  static constexpr uint32_t cMaskNpConfig               = 0x01u <<  3u;   // commands 1-8
+  static constexpr uint32_t cMaskLsHsConfig             = 0x01u <<  2u;
+  static constexpr uint32_t cMaskEnOut                  = 0x01u <<  1u;
+
+  static constexpr uint32_t cShiftDiagOffPulse          =  9u;
+  static constexpr uint32_t cShiftDiagOnPulse           =  1u;
+  static constexpr uint32_t cMaskBridge2currentLimit    = 0x01u << 26u;
+  static constexpr uint32_t cMaskBridge1currentLimit    = 0x01u << 25u;
+
+  static constexpr uint32_t cMaskBistHwscRequest        = 0x03u <<  5u;
+  static constexpr uint32_t cBistRequestYes             = 0x01u <<  5u;
+  static constexpr uint32_t cMaskCommCheckRequest       = 0x03u <<  3u;
+  static constexpr uint32_t cCommCheckRequestYes        = 0x01u <<  3u;
+  static constexpr uint32_t cCommCheckRequestNo         = 0x02u <<  3u;
+  static constexpr uint32_t cMaskDeviceDisState         = 0x01u << 21u;
+  static constexpr uint32_t cMaskDeviceDisLatch         = 0x01u << 20u;
+  static constexpr uint32_t cMaskCommCheckState         = 0x01u << 16u;
+  static constexpr uint32_t cMaskCommCheckLatch         = 0x01u << 15u;
+  static constexpr uint32_t cMaskBistDone               = 0x01u << 14u;
+  static constexpr uint32_t cMaskBistDisableLatch       = 0x01u << 13u;
+  static constexpr uint32_t cMaskHwscDone               = 0x01u << 12u;
+  static constexpr uint32_t cMaskHwscDisableLatch       = 0x01u << 11u;
+  static constexpr uint32_t cMaskPowerOnResetLatch      = 0x01u <<  6u;
+  static constexpr uint32_t cMaskNresLatch              = 0x01u <<  5u;
+  static constexpr uint32_t cMaskVpsUvState             = 0x01u <<  2u;
+  static constexpr uint32_t cMaskVpsUvLatch             = 0x01u <<  1u;
+  // All the latches except the BIST and HWSC results, which stay until the next request.
+  static constexpr uint32_t cClearOnRead10              = 0x055682eau;
+
+  static constexpr uint32_t cShiftExternalFetState      = 17u;
+  static constexpr uint32_t cShiftExternalFetCommand    = 13u;
+  static constexpr uint32_t cShiftPullUpDown            =  1u;
+  static constexpr uint32_t cPullUpDownTriState         =  0u;
+  static constexpr uint32_t cPullUpDownOff              =  2u;
+  static constexpr uint32_t cPullUpDownOnNmos           =  1u;
+  static constexpr uint32_t cPullUpDownOnPmos           =  4u;
+
+  static constexpr uint32_t cMaskNdisProtectLatch       = 0x01u << 23u;
+  static constexpr uint32_t cMaskOverTempState          = 0x01u << 22u;
+  static constexpr uint32_t cMaskSdoOvLatch             = 0x01u << 21u;
+  static constexpr uint32_t cShiftTempAdc               = 11u;
+  static constexpr uint32_t cShiftVpsAdc                =  1u;
+  static constexpr uint32_t cMaskAdc                    = 0x3ffu;
+  static constexpr uint32_t cClearOnRead13              = cMaskNdisProtectLatch | cMaskSdoOvLatch;
+
+  // Channel diagnostics codes, bit n goes to diagnostic bit plane n of command 9.
+  static constexpr uint8_t  cDiagOcFail                 = 1u;
+  static constexpr uint8_t  cDiagStgStbFail             = 2u;
+  static constexpr uint8_t  cDiagOlFail                 = 3u;
+  static constexpr uint8_t  cDiagNoOcFail               = 5u;
+  static constexpr uint8_t  cDiagNoOlStgStbFail         = 6u;
+  static constexpr uint8_t  cDiagNoDiagDone             = 7u;
+
+  static constexpr uint32_t cFixedPatternValues[cRegisterCount] = {
+    0x00000000u, 0x10000000u, 0x20000000u, 0x30000000u, 0x40000000u, 0x50000000u, 0x60000000u,
+    0x70000000u, 0x80000000u, 0x92AA0000u, 0xA2AAAA80u, 0xBAAAAAAAu, 0xCAAAAAABu, 0xDAAAAAAAu
+  };
+
+  static constexpr uint32_t cFixedPatternMasks[cRegisterCount] = {
+    0xF0000000u, 0xF0000000u, 0xF0000000u, 0xF0000000u, 0xF0000000u, 0xF0000000u, 0xF1000000u,
+    0xF1000000u, 0xF0000000u, 0xF7FE0000u, 0xF7FFFF80u, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu
+  };
+
+  std::array<uint32_t, cRegisterCount> mRegisters;     // configuration of commands 0-8, data bits only
+  std::array<uint8_t, cChannelCount>   mDiagnostics;   // latched pulse diagnostics codes
+  std::array<Fault, cChannelCount>     mFaults;
+  std::array<uint16_t, cChannelCount>  mInputs;        // external PWM inputs, Q15 duty
+  uint32_t mPrevious          = cNoCommand;            // command addressed by the previous valid frame
+  uint32_t mLatches10         = 0u;
+  uint32_t mStatus10          = 0u;                    // BIST / HWSC and comm check state bits
+  uint32_t mLatches13         = 0u;
+  uint32_t mPulseOff          = 0u;
+  uint32_t mPulseOn           = 0u;
+  uint64_t mPulseDue          = 0u;
+  uint64_t mBistDue           = 0u;
+  bool     mBistPending       = false;
+  bool     mBistFails         = false;
+  bool     mHwscFails         = false;
+  uint64_t mLastValidFrame    = 0u;
+  uint32_t mCommCheckMicros   = cDefaultCommCheckMicros;
+  uint32_t mTemperatureAdc    = 321u;                  // 25 C
+  uint32_t mBatteryVoltageAdc = 250u;                  // 12 V
+  bool     mInReset           = false;
+  bool     mEnabled           = false;
+  uint32_t mFrameCount        = 0u;
+  uint32_t mIgnoredFrameCount = 0u;
+
+public:
+  L9945simulator() noexcept {
+    mFaults.fill(Fault::cNone);
+    mInputs.fill(0u);
+    powerOnReset();
+  }
+
+  /// Restores the power-on state, and sets the power-on reset latch.
+  void powerOnReset() noexcept {
+    resetRegisters();
+    mLatches10 |= cMaskPowerOnResetLatch;
+  }
+
+  // Transport concept
+
+  L9945transportResult transfer(uint32_t const aTx, uint32_t &aRx) noexcept;
+
+  void enableReset(bool const aEnable) noexcept {
+    if (aEnable) {
+      resetRegisters();
+    }
+    else if (mInReset) {
+      mLatches10 |= cMaskNresLatch;
+    }
+    else { // nothing to do
+    }
+    mInReset = aEnable;
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    if (!aEnable) {
+      mLatches10 |= cMaskDeviceDisLatch;
+    }
+    else { // nothing to do
+    }
+    mEnabled = aEnable;
+  }
+
+  /// @param aChannel channel number from 1 to 8, inclusive.
+  void setInputQ15(uint32_t const aChannel, uint16_t const aDuty) noexcept {
+    mInputs[(aChannel - 1u) % cChannelCount] = aDuty;
+  }
+
+  // Scripting
+
+  /// The fault applies to the load of a channel from now on, and shows up in the diagnostics as on the chip.
+  void setFault(uint32_t const aChannel, Fault const aFault) noexcept {
+    mFaults[(aChannel - 1u) % cChannelCount] = aFault;
+  }
+
+  Fault getFault(uint32_t const aChannel) const noexcept {
+    return mFaults[(aChannel - 1u) % cChannelCount];
+  }
+
+  void setTemperatureAdc(uint32_t const aValue) noexcept {
+    mTemperatureAdc = aValue & cMaskAdc;
+  }
+
+  void setBatteryVoltageAdc(uint32_t const aValue) noexcept {
+    mBatteryVoltageAdc = aValue & cMaskAdc;
+    if (mBatteryVoltageAdc < cVpsUndervoltageAdc) {
+      mLatches10 |= cMaskVpsUvLatch;
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// Makes the next BIST or HWSC report failure.
+  void setSelfTestFailures(bool const aBistFails, bool const aHwscFails) noexcept {
+    mBistFails = aBistFails;
+    mHwscFails = aHwscFails;
+  }
+
+  void setCommCheckMicros(uint32_t const aMicros) noexcept {
+    mCommCheckMicros = aMicros;
+  }
+
+  void setSdoOvervoltage() noexcept {
+    mLatches13 |= cMaskSdoOvLatch;
+  }
+
+  // Inspection
+
+  bool isOutputOn(uint32_t const aChannel) const noexcept {
+    return isOn((aChannel - 1u) % cChannelCount);
+  }
+
+  uint16_t getInputQ15(uint32_t const aChannel) const noexcept {
+    return mInputs[(aChannel - 1u) % cChannelCount];
+  }
+
+  /// @returns the current response word for a command without the side effects of reading it.
+  uint32_t peek(uint32_t const aCommand) const noexcept {
+    return aCommand < cRegisterCount ? addParity(aCommand << 28u | (getContent(aCommand) & cMaskData)) : addParity(cNoCommand << 28u);
+  }
+
+  uint32_t getFrameCount() const noexcept {
+    return mFrameCount;
+  }
+
+  /// Frames ignored due to parity error, invalid command, wrong fixed pattern or reset.
+  uint32_t getIgnoredFrameCount() const noexcept {
+    return mIgnoredFrameCount;
+  }
+
+private:
+  static uint32_t addParity(uint32_t const aValue) noexcept {
+    return aValue | l9945::calculateParity(aValue);
+  }
+
+  static uint32_t getWriteMask(uint32_t const aCommand) noexcept {
+    return ~(cFixedPatternMasks[aCommand] | cMaskRead) & cMaskData;
+  }
+
+  bool isLs(uint32_t const aIndex) const noexcept {
+    return (mRegisters[aIndex + 1u] & cMaskLsHsConfig) == 0u;
+  }
+
+  bool isOn(uint32_t const aIndex) const noexcept;
+  bool isOutputHigh(uint32_t const aIndex) const noexcept;
+  uint8_t diagnoseOn(uint32_t const aIndex) const noexcept;
+  uint8_t diagnoseOff(uint32_t const aIndex) const noexcept;
+  void resetRegisters() noexcept;
+  void update(uint64_t const aNow) noexcept;
+  uint32_t getContent(uint32_t const aCommand) const noexcept;
+  void execute(uint32_t const aCommand, uint32_t const aFrame, uint64_t const aNow) noexcept;
+};
+
+inline L9945transportResult L9945simulator::transfer(uint32_t const aTx, uint32_t &aRx) noexcept {
+  uint64_t now = L9945hostClock::getMicros();
+  ++mFrameCount;
+  update(now);
+  if (mInReset) {
+    aRx = 0u;
+    ++mIgnoredFrameCount;
+  }
+  else {
+    aRx = peek(mPrevious);
+    if (mPrevious == cCommand9) {
+      if ((mRegisters[cCommand0] & cMaskEnableDiagnostics) == 0u) {
+        mDiagnostics.fill(cDiagNoDiagDone);
+      }
+      else { // nothing to do, automatic diagnostics is continuous
+      }
+    }
+    else if (mPrevious == cCommand10) {
+      mLatches10 &= ~cClearOnRead10;
+    }
+    else if (mPrevious == cCommand13) {
+      mLatches13 &= ~cClearOnRead13;
+    }
+    else { // nothing to do
+    }
+    uint32_t command = aTx >> 28u;
+    if (l9945::calculateParity(aTx) == 0u && command < cRegisterCount &&
+      (aTx & cFixedPatternMasks[command]) == (cFixedPatternValues[command] & cFixedPatternMasks[command])) {
+      mLastValidFrame = now;
+      mPrevious = command;
+      if ((aTx & cMaskRead) == 0u) {
+        execute(command, aTx, now);
+      }
+      else { // nothing to do
+      }
+    }
+    else {
+      mPrevious = cNoCommand;
+      ++mIgnoredFrameCount;
+    }
+  }
+  return L9945transportResult::cOk;
+}
+
+inline bool L9945simulator::isOn(uint32_t const aIndex) const noexcept {
+  uint32_t config0 = mRegisters[cCommand0];
+  bool commanded = ((config0 >> cShiftSpiInputSelect) & (1u << aIndex)) > 0u ?
+                   ((config0 >> cShiftSpiOnOut) & (1u << aIndex)) > 0u :
+                   mInputs[aIndex] > 0u;
+  return mEnabled && !mInReset && (mRegisters[aIndex + 1u] & cMaskEnOut) > 0u && commanded;
+}
+
+inline bool L9945simulator::isOutputHigh(uint32_t const aIndex) const noexcept {
+  bool result;
+  if (mFaults[aIndex] == Fault::cShortToGround) {
+    result = false;
+  }
+  else if (mFaults[aIndex] == Fault::cShortToBattery) {
+    result = true;
+  }
+  else {
+    result = isOn(aIndex) != isLs(aIndex);
+  }
+  return result;
+}
+
+inline uint8_t L9945simulator::diagnoseOn(uint32_t const aIndex) const noexcept {
+  Fault fault = mFaults[aIndex];
+  bool shorted = (fault == Fault::cShortToBattery && isLs(aIndex)) || (fault == Fault::cShortToGround && !isLs(aIndex));
+  return fault == Fault::cOverCurrent || shorted ? cDiagOcFail : cDiagNoOcFail;
+}
+
+inline uint8_t L9945simulator::diagnoseOff(uint32_t const aIndex) const noexcept {
+  uint8_t result;
+  if (mFaults[aIndex] == Fault::cOpenLoad) {
+    result = cDiagOlFail;
+  }
+  else if (mFaults[aIndex] == Fault::cShortToGround || mFaults[aIndex] == Fault::cShortToBattery) {
+    result = cDiagStgStbFail;
+  }
+  else {
+    result = cDiagNoOlStgStbFail;
+  }
+  return result;
+}
+
+inline void L9945simulator::resetRegisters() noexcept {
+  mRegisters.fill(0u);
+  mDiagnostics.fill(cDiagNoDiagDone);
+  mPrevious = cNoCommand;
+  mLatches10 = 0u;
+  mStatus10 = 0u;
+  mLatches13 = 0u;
+  mPulseOff = 0u;
+  mPulseOn = 0u;
+  mBistPending = false;
+}
+
+inline void L9945simulator::update(uint64_t const aNow) noexcept {
+  if ((mPulseOff | mPulseOn) != 0u && aNow >= mPulseDue) {
+    for (uint32_t i = 0u; i < cChannelCount; ++i) {
+      if ((mPulseOff & (1u << i)) > 0u) {
+        mDiagnostics[i] = diagnoseOff(i);
+      }
+      else if ((mPulseOn & (1u << i)) > 0u) {
+        mDiagnostics[i] = diagnoseOn(i);
+      }
+      else { // nothing to do
+      }
+    }
+    mPulseOff = 0u;
+    mPulseOn = 0u;
+  }
+  else { // nothing to do
+  }
+  if (mBistPending && aNow >= mBistDue) {
+    mBistPending = false;
+    mStatus10 |= cMaskBistDone | cMaskHwscDone | (mBistFails ? cMaskBistDisableLatch : 0u) | (mHwscFails ? cMaskHwscDisableLatch : 0u);
+  }
+  else { // nothing to do
+  }
+  if ((mStatus10 & cMaskCommCheckState) > 0u && aNow - mLastValidFrame > mCommCheckMicros) {
+    mLatches10 |= cMaskCommCheckLatch;
+  }
+  else { // nothing to do
+  }
+  if (mBatteryVoltageAdc < cVpsUndervoltageAdc) {
+    mLatches10 |= cMaskVpsUvLatch;
+  }
+  else { // nothing to do
+  }
+}
+
+inline uint32_t L9945simulator::getContent(uint32_t const aCommand) const noexcept {
+  uint32_t result = 0u;
+  if (aCommand == cCommand0) {
+    result = mRegisters[cCommand0] & ~(0xffu << cShiftSpiOnOut);
+    for (uint32_t i = 0u; i < cChannelCount; ++i) {
+      result |= (isOutputHigh(i) ? 1u : 0u) << (cShiftSpiOnOut + i);
+    }
+  }
+  else if (aCommand < cCommand9) {
+    result = mRegisters[aCommand];
+  }
+  else if (aCommand == cCommand9) {
+    bool automatic = (mRegisters[cCommand0] & cMaskEnableDiagnostics) > 0u;
+    uint32_t protectionDisabled = mRegisters[cCommand0] >> cShiftProtectionDisable;
+    bool overCurrent[2] = { false, false };
+    for (uint32_t i = 0u; i < cChannelCount; ++i) {
+      uint8_t code = mDiagnostics[i];
+      if (((mPulseOff | mPulseOn) & (1u << i)) > 0u) {
+        code = cDiagNoDiagDone;
+      }
+      else if (automatic && (protectionDisabled & (1u << i)) == 0u) {
+        code = isOn(i) ? diagnoseOn(i) : diagnoseOff(i);
+      }
+      else { // nothing to do
+      }
+      result |= (static_cast<uint32_t>(code & 1u) << 1u | static_cast<uint32_t>((code >> 1u) & 1u) << 9u | static_cast<uint32_t>(code >> 2u) << 17u) << i;
+      overCurrent[i / 4u] = overCurrent[i / 4u] || (isOn(i) && diagnoseOn(i) == cDiagOcFail);
+    }
+    for (uint32_t bridge = 0u; bridge < 2u; ++bridge) {
+      if (overCurrent[bridge] && (mRegisters[4u + bridge * 4u] & cMaskBridgeConfig) > 0u && (mRegisters[3u + bridge * 4u] & cMaskCurrentLimitEnable) > 0u) {
+        result |= (bridge == 0u ? cMaskBridge1currentLimit : cMaskBridge2currentLimit);
+      }
+      else { // nothing to do
+      }
+    }
+  }
+  else if (aCommand == cCommand10) {
+    result = mLatches10 | mStatus10 | (mEnabled ? 0u : cMaskDeviceDisState) | (mBatteryVoltageAdc < cVpsUndervoltageAdc ? cMaskVpsUvState : 0u);
+  }
+  else if (aCommand < cCommand13) {
+    uint32_t first = (aCommand - 11u) * 4u;
+    for (uint32_t i = 0u; i < 4u; ++i) {
+      uint32_t index = first + i;
+      bool on = isOn(index);
+      bool pmos = !isLs(index) && (mRegisters[index + 1u] & cMaskNpConfig) > 0u;
+      uint32_t pullUpDown;
+      if (!mEnabled) {
+        pullUpDown = cPullUpDownTriState;
+      }
+      else if (on) {
+        pullUpDown = (pmos ? cPullUpDownOnPmos : cPullUpDownOnNmos);
+      }
+      else {
+        pullUpDown = cPullUpDownOff;
+      }
+      result |= ((on != isLs(index)) ? 1u : 0u) << (cShiftExternalFetState + i);
+      result |= (on ? 1u : 0u) << (cShiftExternalFetCommand + i);
+      result |= pullUpDown << (cShiftPullUpDown + 3u * i);
+    }
+  }
+  else {
+    result = mLatches13 | (mTemperatureAdc >= cOverTemperatureAdc ? cMaskOverTempState : 0u) |
+             mTemperatureAdc << cShiftTempAdc | mBatteryVoltageAdc << cShiftVpsAdc;
+  }
+  return result;
+}
+
+inline void L9945simulator::execute(uint32_t const aCommand, uint32_t const aFrame, uint64_t const aNow) noexcept {
+  if (aCommand < cCommand9) {
+    mRegisters[aCommand] = aFrame & getWriteMask(aCommand);
+  }
+  else if (aCommand == cCommand9) {
+    mPulseOff |= (aFrame >> cShiftDiagOffPulse) & 0xffu;
+    mPulseOn |= (aFrame >> cShiftDiagOnPulse) & 0xffu & ~mPulseOff;
+    mPulseDue = aNow + cPulseTestMicros;
+  }
+  else if (aCommand == cCommand10) {
+    if ((aFrame & cMaskBistHwscRequest) == cBistRequestYes) {
+      mStatus10 &= ~(cMaskBistDone | cMaskBistDisableLatch | cMaskHwscDone | cMaskHwscDisableLatch);
+      mBistPending = true;
+      mBistDue = aNow + cBistMicros;
+    }
+    else { // nothing to do
+    }
+    if ((aFrame & cMaskCommCheckRequest) == cCommCheckRequestYes) {
+      mStatus10 |= cMaskCommCheckState;
+    }
+    else if ((aFrame & cMaskCommCheckRequest) == cCommCheckRequestNo) {
+      mStatus10 &= ~cMaskCommCheckState;
+    }
+    else { // nothing to do
+    }
+  }
+  else { // nothing to do, read-only
+  }
+}
+
+/// Host-side tInterface for L9945 over a transport, which can be L9945simulator itself
+/// or a wrapper around it. The transport needs these methods:
+///   L9945transportResult transfer(uint32_t const aTx, uint32_t &aRx) noexcept;
+///   void enableReset(bool const aEnable) noexcept;
+///   void enableAll(bool const aEnable) noexcept;
+///   void setInputQ15(uint32_t const aChannel, uint16_t const aDuty) noexcept;
+/// Delays and SPI frames advance L9945hostClock. Each 4 bytes of a transfer are a separate frame.
+/// Bridge PWM drives input 1 of the bridge forward and input 2 reverse.
+template<typename tTransport>
+class L9945hostInterface final {
+public:
+  using Driver = L9945<L9945hostInterface<tTransport>>;
+
+private:
+  static constexpr uint32_t cFrameBits = 32u;
+  static constexpr int32_t  cQ15one    = 32767;
+
+  tTransport   &mTransport;
+  uint32_t      mFrameMicros;
+  std::ostream *mLog;
+  bool          mSelected        = false;
+  uint32_t      mFatalErrorCount = 0u;
+  uint32_t      mLastFatalError  = 0u;
+
+public:
+  /// @param aSpiClockHz used to calculate the simulated duration of the frames
+  /// @param aLog        destination of the diagnostics log, nothing is logged if nullptr
+  L9945hostInterface(tTransport &aTransport, uint32_t const aSpiClockHz = 4000000u, std::ostream * const aLog = nullptr) noexcept
+  : mTransport(aTransport)
+  , mFrameMicros((cFrameBits * 1000000u + aSpiClockHz - 1u) / aSpiClockHz)
+  , mLog(aLog) {
+  }
+
+  tTransport& getTransport() noexcept {
+    return mTransport;
+  }
+
+  uint32_t getFatalErrorCount() const noexcept {
+    return mFatalErrorCount;
+  }
+
+  typename Driver::Exception getLastFatalError() const noexcept {
+    return static_cast<typename Driver::Exception>(mLastFatalError);
+  }
+
+  static void delayMs(uint32_t const aDelay) noexcept {
+    L9945hostClock::advanceMicros(aDelay * 1000ull);
+  }
+
+  void enableReset(bool const aEnable) noexcept {
+    mTransport.enableReset(aEnable);
+  }
+
+  void enableSpiTransfer(bool const aEnable) noexcept {
+    mSelected = aEnable;
+  }
+
+  void enableAll(bool const aEnable) noexcept {
+    mTransport.enableAll(aEnable);
+  }
+
+  void fatalError(typename Driver::Exception const aException) noexcept {
+    ++mFatalErrorCount;
+    mLastFatalError = static_cast<uint32_t>(aException);
+  }
+
+  typename Driver::SpiResult spiTransmitReceive(uint8_t const* const aTxData, uint8_t* const aRxData, uint16_t const aSize) noexcept {
+    L9945transportResult result = (mSelected && aSize % sizeof(uint32_t) == 0u ? L9945transportResult::cOk : L9945transportResult::cError);
+    for (uint16_t i = 0u; result == L9945transportResult::cOk && i < aSize; i += sizeof(uint32_t)) {
+      uint32_t rx = 0u;
+      result = mTransport.transfer(l9945::bytes2word(aTxData + i), rx);
+      L9945hostClock::advanceMicros(mFrameMicros);
+      aRxData[i]      = static_cast<uint8_t>(rx >> 24u);
+      aRxData[i + 1u] = static_cast<uint8_t>(rx >> 16u);
+      aRxData[i + 2u] = static_cast<uint8_t>(rx >> 8u);
+      aRxData[i + 3u] = static_cast<uint8_t>(rx);
+    }
+    return static_cast<typename Driver::SpiResult>(result);
+  }
+
+  void setPwm(float const aValue, typename Driver::Bridge const aBridge) noexcept {
+    setPwmQ15(static_cast<int32_t>(aValue * cQ15one), aBridge);
+  }
+
+  void setPwm(float const aValue, uint32_t const aChannel) noexcept {
+    setPwmQ15(static_cast<int32_t>(aValue * cQ15one), aChannel);
+  }
+
+  void setPwmQ15(int32_t const aValue, typename Driver::Bridge const aBridge) noexcept {
+    uint32_t first = static_cast<uint32_t>(aBridge) + 1u;
+    int32_t value = std::min(std::max(aValue, -cQ15one), cQ15one);
+    mTransport.setInputQ15(first, static_cast<uint16_t>(value > 0 ? value : 0));
+    mTransport.setInputQ15(first + 1u, static_cast<uint16_t>(value < 0 ? -value : 0));
+  }
+
+  void setPwmQ15(int32_t const aValue, uint32_t const aChannel) noexcept {
+    mTransport.setInputQ15(aChannel, static_cast<uint16_t>(std::min(std::max(aValue, 0), cQ15one)));
+  }
+
+  uint32_t getMicros() noexcept {
+    return static_cast<uint32_t>(L9945hostClock::getMicros());
+  }
+
+  void open() noexcept {
+  }
+
+  template<typename ToAppend>
+  L9945hostInterface& operator<<(ToAppend aWhat) noexcept {
+    if (mLog != nullptr) {
+      *mLog << aWhat;
+    }
+    else { // nothing to do
+    }
+    return *this;
+  }
+
+  void close() noexcept {
+    if (mLog != nullptr) {
+      mLog->flush();
+    }
+    else { // nothing to do
+    }
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+
+#ifndef NOWTECH_L9945_SOFT_PWM_H
+#define NOWTECH_L9945_SOFT_PWM_H
+
+#include <array>
+#include <cstdint>
+#include "L9945.h"
+
+namespace nowtech {
+
+/// Low frequency PWM and pulse patterns on SPI controlled channels (spiInputSelect set), using the
+/// spiOnOut bits of command 0. The period consists of tSlotCount slots, and tick() has to be called
+/// once per slot. The spiOnOut mask of each slot is precomputed when the patterns change, so a tick
+/// is a table lookup, and a single frame carrying all the channels is sent only at change points.
+/// Patterns must not be modified concurrently with tick().
+template<typename tL9945, uint32_t tSlotCount>
+class L9945softPwm final {
+  static_assert(tSlotCount > 0u);
+
+public:
+  static constexpr uint32_t cChannelCount = 8u;
+
+private:
+  tL9945                              &mDriver;
+  std::array<uint8_t, tSlotCount>      mSlotMasks = {};   // bit 0 for channel 1
+  uint32_t                             mChannels = 0u;     // channels under control
+  uint32_t                             mSlot = 0u;
+  uint32_t                             mLastMask = 0u;
+  bool                                 mFirst = true;     // the first tick sends the mask anyway
+  uint32_t                             mFrames = 0u;
+
+public:
+  L9945softPwm(tL9945 &aDriver) noexcept : mDriver(aDriver) {
+  }
+
+  /// Switches aChannel on for aOnSlots slots of every period starting at slot aPhase.
+  /// @param aChannel channel number from 1 to 8, inclusive.
+  void setDuty(uint32_t const aChannel, uint32_t const aOnSlots, uint32_t const aPhase = 0u) noexcept {
+    if (aChannel - 1u < cChannelCount) {
+      for (uint32_t slot = 0u; slot < tSlotCount; ++slot) {
+        setSlotBit(aChannel - 1u, slot, (slot + tSlotCount - aPhase % tSlotCount) % tSlotCount < aOnSlots);
+      }
+      control(aChannel - 1u);
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// Sets the state of aChannel in a single slot, for arbitrary pulse patterns.
+  void setSlot(uint32_t const aChannel, uint32_t const aSlot, bool const aOn) noexcept {
+    if (aChannel - 1u < cChannelCount && aSlot < tSlotCount) {
+      setSlotBit(aChannel - 1u, aSlot, aOn);
+      control(aChannel - 1u);
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// Stops controlling aChannel. Its spiOnOut bit keeps its last value.
+  void release(uint32_t const aChannel) noexcept {
+    if (aChannel - 1u < cChannelCount) {
+      mChannels &= ~(1u << (aChannel - 1u));
+      for (auto &mask : mSlotMasks) {
+        mask &= ~(1u << (aChannel - 1u));
+      }
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// Restarts the period with the next tick, which always sends the actual mask.
+  void restart() noexcept {
+    mSlot = 0u;
+    mFirst = true;
+  }
+
+  /// Sends a frame if the mask of the actual slot differs from the last one sent.
+  /// @returns false if sending the frame failed.
+  bool tick();
+
+  uint32_t getSlot() const noexcept {
+    return mSlot;
+  }
+
+  /// @returns the number of frames sent so far.
+  uint32_t getFrameCount() const noexcept {
+    return mFrames;
+  }
+
+  /// @returns the number of frames per period in steady state, which is the number of change points.
+  uint32_t getFramesPerPeriod() const noexcept;
+
+private:
+  /// A newly controlled channel may differ from its slot mask even if the mask is unchanged, so the next tick sends it.
+  void control(uint32_t const aIndex) noexcept {
+    if ((mChannels & (1u << aIndex)) == 0u) {
+      mChannels |= 1u << aIndex;
+      mFirst = true;
+    }
+    else { // nothing to do
+    }
+  }
+
+  void setSlotBit(uint32_t const aIndex, uint32_t const aSlot, bool const aOn) noexcept {
+    mSlotMasks[aSlot] = static_cast<uint8_t>((mSlotMasks[aSlot] & ~(1u << aIndex)) | ((aOn ? 1u : 0u) << aIndex));
+  }
+};
+
+template<typename tL9945, uint32_t tSlotCount>
+bool L9945softPwm<tL9945, tSlotCount>::tick() {
+  bool result = true;
+  uint32_t mask = mSlotMasks[mSlot];
+  if (mChannels > 0u && (mFirst || mask != mLastMask)) {
+    result = mDriver.postSpiOnOutMask(mask, mChannels);
+    ++mFrames;
+    if (result) {
+      mLastMask = mask;
+      mFirst = false;
+    }
+    else { // nothing to do, the next tick tries again
+    }
+  }
+  else { // nothing to do
+  }
+  mSlot = (mSlot + 1u) % tSlotCount;
+  return result;
+}
+
+template<typename tL9945, uint32_t tSlotCount>
+uint32_t L9945softPwm<tL9945, tSlotCount>::getFramesPerPeriod() const noexcept {
+  uint32_t result = 0u;
+  for (uint32_t slot = 0u; slot < tSlotCount; ++slot) {
+    result += (mSlotMasks[slot] != mSlotMasks[(slot + tSlotCount - 1u) % tSlotCount] ? 1u : 0u);
+  }
+  return result;
+}
+
+}
+
+#endif
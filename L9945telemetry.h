@@ -0,0 +1,361 @@
+
+#ifndef NOWTECH_L9945_TELEMETRY_H
+#define NOWTECH_L9945_TELEMETRY_H
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include "L9945.h"
+
+namespace nowtech {
+
+/// Fixed-memory rolling window of the last tLength raw ADC samples.
+template<uint32_t tLength>
+class L9945rollingWindow final {
+  static_assert(tLength > 0u);
+
+private:
+  std::array<uint16_t, tLength> mSamples;
+  uint32_t                      mNext  = 0u;
+  uint32_t                      mCount = 0u;
+  uint32_t                      mSum   = 0u;
+
+public:
+  void clear() noexcept {
+    mNext = 0u;
+    mCount = 0u;
+    mSum = 0u;
+  }
+
+  void push(uint16_t const aSample) noexcept {
+    if (mCount == tLength) {
+      mSum -= mSamples[mNext];
+    }
+    else {
+      ++mCount;
+    }
+    mSamples[mNext] = aSample;
+    mSum += aSample;
+    mNext = (mNext + 1u) % tLength;
+  }
+
+  uint32_t getCount() const noexcept {
+    return mCount;
+  }
+
+  uint16_t getLast() const noexcept {
+    return mCount > 0u ? mSamples[(mNext + tLength - 1u) % tLength] : 0u;
+  }
+
+  /// Rounded mean of the samples in the window.
+  uint16_t getMean() const noexcept {
+    return mCount > 0u ? static_cast<uint16_t>((mSum + mCount / 2u) / mCount) : 0u;
+  }
+
+  uint16_t getMin() const noexcept {
+    return mCount > 0u ? *std::min_element(mSamples.cbegin(), mSamples.cbegin() + mCount) : 0u;
+  }
+
+  uint16_t getMax() const noexcept {
+    return mCount > 0u ? *std::max_element(mSamples.cbegin(), mSamples.cbegin() + mCount) : 0u;
+  }
+};
+
+/// Samples the temperature and battery voltage ADC values of an L9945 using a single
+/// command 13 read per tick. Stage 0 keeps the raw samples, each further stage keeps
+/// the means of tDecimation consecutive samples of the previous one. This way stage n
+/// covers tWindowLength * tDecimation^n ticks.
+/// The raw values can be converted using L9945::adc2milliCelsius and L9945::adc2milliVolt.
+template<typename tL9945, uint32_t tWindowLength, uint32_t tStageCount = 1u, uint32_t tDecimation = 8u>
+class L9945telemetrySampler final {
+  static_assert(tStageCount > 0u);
+  static_assert(tDecimation > 1u);
+
+public:
+  using Window = L9945rollingWindow<tWindowLength>;
+
+private:
+  struct Stage final {
+    Window   mTemperature;
+    Window   mBatteryVoltage;
+    uint32_t mTemperatureSum    = 0u;
+    uint32_t mBatteryVoltageSum = 0u;
+    uint32_t mPhase             = 0u;
+  };
+
+  tL9945                            &mDriver;
+  std::array<Stage, tStageCount>     mStages;
+
+public:
+  L9945telemetrySampler(tL9945 &aDriver) noexcept : mDriver(aDriver) {
+  }
+
+  /// To be called once in each sampling period.
+  /// @returns false if the sample could not be obtained due to an SPI failure.
+  bool tick() {
+    uint32_t temperature = mDriver.readTemperatureAdc();
+    uint32_t batteryVoltage = mDriver.getBatteryVoltageAdc();     // arrived in the same frame
+    bool result = !mDriver.hasSpiEverFailed();
+    if (result) {
+      push(static_cast<uint16_t>(temperature), static_cast<uint16_t>(batteryVoltage));
+    }
+    else { // nothing to do
+    }
+    return result;
+  }
+
+  void clear() noexcept {
+    for (auto &stage : mStages) {
+      stage = Stage();
+    }
+  }
+
+  Window const& getTemperature(uint32_t const aStage = 0u) const noexcept {
+    return mStages[std::min(aStage, tStageCount - 1u)].mTemperature;
+  }
+
+  Window const& getBatteryVoltage(uint32_t const aStage = 0u) const noexcept {
+    return mStages[std::min(aStage, tStageCount - 1u)].mBatteryVoltage;
+  }
+
+private:
+  void push(uint16_t const aTemperature, uint16_t const aBatteryVoltage) noexcept {
+    uint16_t temperature = aTemperature;
+    uint16_t batteryVoltage = aBatteryVoltage;
+    bool propagate = true;
+    for (uint32_t i = 0u; propagate && i < tStageCount; ++i) {
+      Stage &stage = mStages[i];
+      stage.mTemperature.push(temperature);
+      stage.mBatteryVoltage.push(batteryVoltage);
+      stage.mTemperatureSum += temperature;
+      stage.mBatteryVoltageSum += batteryVoltage;
+      propagate = (++stage.mPhase == tDecimation);
+      if (propagate) {
+        temperature = static_cast<uint16_t>((stage.mTemperatureSum + tDecimation / 2u) / tDecimation);
+        batteryVoltage = static_cast<uint16_t>((stage.mBatteryVoltageSum + tDecimation / 2u) / tDecimation);
+        stage.mTemperatureSum = 0u;
+        stage.mBatteryVoltageSum = 0u;
+        stage.mPhase = 0u;
+      }
+      else { // nothing to do
+      }
+    }
+  }
+};
+
+namespace l9945 {
+
+class BitWriter final {
+private:
+  uint8_t  *mData;
+  uint32_t  mBitPosition = 0u;
+
+public:
+  BitWriter(uint8_t * const aData) noexcept : mData(aData) {
+  }
+
+  void write(uint32_t const aValue, uint32_t const aBitCount) noexcept {
+    for (uint32_t i = 0u; i < aBitCount; ++i, ++mBitPosition) {
+      uint8_t mask = static_cast<uint8_t>(1u << (mBitPosition & 7u));
+      mData[mBitPosition >> 3u] = ((aValue >> i) & 1u) > 0u ? mData[mBitPosition >> 3u] | mask : mData[mBitPosition >> 3u] & ~mask;
+    }
+  }
+
+  uint32_t getByteCount() const noexcept {
+    return (mBitPosition + 7u) >> 3u;
+  }
+};
+
+class BitReader final {
+private:
+  uint8_t const *mData;
+  uint32_t       mBitPosition = 0u;
+
+public:
+  BitReader(uint8_t const * const aData) noexcept : mData(aData) {
+  }
+
+  uint32_t read(uint32_t const aBitCount) noexcept {
+    uint32_t result = 0u;
+    for (uint32_t i = 0u; i < aBitCount; ++i, ++mBitPosition) {
+      result |= ((mData[mBitPosition >> 3u] >> (mBitPosition & 7u)) & 1u) << i;
+    }
+    return result;
+  }
+};
+
+constexpr uint32_t zigzagEncode(int32_t const aValue) noexcept {
+  return (static_cast<uint32_t>(aValue) << 1u) ^ static_cast<uint32_t>(aValue >> 31u);
+}
+
+constexpr int32_t zigzagDecode(uint32_t const aValue) noexcept {
+  return static_cast<int32_t>(aValue >> 1u) ^ -static_cast<int32_t>(aValue & 1u);
+}
+
+}
+
+/// Block codec for slowly changing 10-bit ADC series (command 13 temperature or battery voltage).
+/// A block holds at most tBlockLength samples:
+/// - 8 bits sample count
+/// - 10 bits first sample
+/// - 11 bits zigzag coded first delta
+/// - 4 bits width of the delta-of-delta values
+/// - zigzag coded delta-of-delta values of the remaining samples on that width.
+template<uint32_t tBlockLength>
+class L9945telemetryCodec final {
+  static_assert(tBlockLength >= 2u && tBlockLength <= 255u);
+
+public:
+  static constexpr uint32_t cSampleBits      = 10u;
+  static constexpr uint32_t cSampleMask      = (1u << cSampleBits) - 1u;
+  static constexpr uint32_t cCountBits       =  8u;
+  static constexpr uint32_t cDeltaBits       = cSampleBits + 1u;
+  static constexpr uint32_t cWidthBits       =  4u;
+  static constexpr uint32_t cMaxBlockBytes   = (cCountBits + cSampleBits + cDeltaBits + cWidthBits + (tBlockLength - 2u) * (cDeltaBits + 1u) + 7u) / 8u;
+
+  /// @returns the number of bytes written to aOut, which must have at least cMaxBlockBytes space.
+  static uint32_t encode(uint16_t const * const aSamples, uint32_t const aCount, uint8_t * const aOut) noexcept {
+    uint32_t count = std::min(aCount, tBlockLength);
+    l9945::BitWriter writer(aOut);
+    writer.write(count, cCountBits);
+    if (count > 0u) {
+      writer.write(aSamples[0] & cSampleMask, cSampleBits);
+    }
+    else { // nothing to do
+    }
+    if (count > 1u) {
+      int32_t firstDelta = static_cast<int32_t>(aSamples[1] & cSampleMask) - static_cast<int32_t>(aSamples[0] & cSampleMask);
+      writer.write(l9945::zigzagEncode(firstDelta), cDeltaBits);
+      uint32_t width = 0u;
+      for (uint32_t i = 2u; i < count; ++i) {
+        width = std::max(width, l9945::getBitWidth(l9945::zigzagEncode(getDeltaOfDelta(aSamples, i))));
+      }
+      writer.write(width, cWidthBits);
+      for (uint32_t i = 2u; i < count; ++i) {
+        writer.write(l9945::zigzagEncode(getDeltaOfDelta(aSamples, i)), width);
+      }
+    }
+    else { // nothing to do
+    }
+    return writer.getByteCount();
+  }
+
+  /// @returns the number of samples written to aOut, which must have at least tBlockLength space.
+  static uint32_t decode(uint8_t const * const aData, uint16_t * const aOut) noexcept {
+    l9945::BitReader reader(aData);
+    uint32_t count = std::min(reader.read(cCountBits), tBlockLength);
+    if (count > 0u) {
+      aOut[0] = static_cast<uint16_t>(reader.read(cSampleBits));
+    }
+    else { // nothing to do
+    }
+    if (count > 1u) {
+      int32_t delta = l9945::zigzagDecode(reader.read(cDeltaBits));
+      int32_t previous = aOut[0] + delta;
+      aOut[1] = static_cast<uint16_t>(previous & cSampleMask);
+      uint32_t width = reader.read(cWidthBits);
+      for (uint32_t i = 2u; i < count; ++i) {
+        delta += l9945::zigzagDecode(reader.read(width));
+        previous += delta;
+        aOut[i] = static_cast<uint16_t>(previous & cSampleMask);
+      }
+    }
+    else { // nothing to do
+    }
+    return count;
+  }
+
+private:
+  static int32_t getDeltaOfDelta(uint16_t const * const aSamples, uint32_t const aIndex) noexcept {
+    return static_cast<int32_t>(aSamples[aIndex] & cSampleMask) - 2 * static_cast<int32_t>(aSamples[aIndex - 1u] & cSampleMask)
+         + static_cast<int32_t>(aSamples[aIndex - 2u] & cSampleMask);
+  }
+};
+
+/// Streaming compressor keeping the history of a 10-bit ADC series in tCapacityBytes
+/// of compressed blocks. When full, the oldest blocks are dropped.
+template<uint32_t tBlockLength, uint32_t tCapacityBytes>
+class L9945telemetryHistory final {
+public:
+  using Codec = L9945telemetryCodec<tBlockLength>;
+  static_assert(Codec::cMaxBlockBytes <= 255u);
+  static_assert(tCapacityBytes >= Codec::cMaxBlockBytes + 1u);
+
+private:
+  std::array<uint16_t, tBlockLength> mPending;
+  uint32_t                           mPendingCount = 0u;
+  std::array<uint8_t, tCapacityBytes> mStore;     // blocks, each prefixed by its size in bytes
+  uint32_t                           mStoreUsed   = 0u;
+  uint32_t                           mBlockCount  = 0u;
+
+public:
+  void push(uint16_t const aSample) noexcept {
+    mPending[mPendingCount] = aSample;
+    ++mPendingCount;
+    if (mPendingCount == tBlockLength) {
+      flush();
+    }
+    else { // nothing to do
+    }
+  }
+
+  /// Compresses the pending samples into a block, even if it is not full.
+  void flush() noexcept {
+    if (mPendingCount > 0u) {
+      std::array<uint8_t, Codec::cMaxBlockBytes> block;
+      uint32_t size = Codec::encode(mPending.data(), mPendingCount, block.data());
+      while (mStoreUsed + size + 1u > tCapacityBytes) {
+        dropOldestBlock();
+      }
+      mStore[mStoreUsed] = static_cast<uint8_t>(size);
+      std::copy(block.cbegin(), block.cbegin() + size, mStore.begin() + mStoreUsed + 1u);
+      mStoreUsed += size + 1u;
+      ++mBlockCount;
+      mPendingCount = 0u;
+    }
+    else { // nothing to do
+    }
+  }
+
+  void clear() noexcept {
+    mPendingCount = 0u;
+    mStoreUsed = 0u;
+    mBlockCount = 0u;
+  }
+
+  uint32_t getBlockCount() const noexcept {
+    return mBlockCount;
+  }
+
+  uint32_t getUsedBytes() const noexcept {
+    return mStoreUsed;
+  }
+
+  /// Decodes the stored blocks from the oldest one, and then the not yet compressed samples.
+  /// @returns the number of samples written to aOut.
+  uint32_t decode(uint16_t * const aOut, uint32_t const aMaxCount) const noexcept {
+    uint32_t result = 0u;
+    std::array<uint16_t, tBlockLength> block;
+    for (uint32_t position = 0u; position < mStoreUsed; position += mStore[position] + 1u) {
+      uint32_t count = Codec::decode(mStore.data() + position + 1u, block.data());
+      count = std::min(count, aMaxCount - result);
+      std::copy(block.cbegin(), block.cbegin() + count, aOut + result);
+      result += count;
+    }
+    uint32_t count = std::min(mPendingCount, aMaxCount - result);
+    std::copy(mPending.cbegin(), mPending.cbegin() + count, aOut + result);
+    return result + count;
+  }
+
+private:
+  void dropOldestBlock() noexcept {
+    uint32_t size = mStore[0u] + 1u;
+    std::copy(mStore.cbegin() + size, mStore.cbegin() + mStoreUsed, mStore.begin());
+    mStoreUsed -= size;
+    --mBlockCount;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+
+#ifndef NOWTECH_L9945_TRACE_EXPORT_H
+#define NOWTECH_L9945_TRACE_EXPORT_H
+
+#include <cstdint>
+#include <ostream>
+#include "L9945.h"
+
+namespace nowtech {
+
+/// Host-side exporter of the frame trace of an L9945 instance (see NOWTECH_L9945_TRACE_LENGTH)
+/// to the Chrome / Perfetto JSON trace format. Each frame becomes a complete event lasting
+/// until the next frame, command frames on thread 1 and dummy frames on thread 2.
+/// @param aProcessId can be used to distinguish several chips in the same timeline.
+template<typename tL9945>
+void exportL9945trace(std::ostream &aOut, tL9945 const &aDriver, uint32_t const aProcessId = 1u) {
+  static constexpr char cHex[] = "0123456789abcdef";
+  auto hex = [&aOut](uint32_t const aValue) {
+    aOut << "\"0x";
+    for (int32_t shift = 28; shift >= 0; shift -= 4) {
+      aOut << cHex[(aValue >> shift) & 0xfu];
+    }
+    aOut << '"';
+  };
+  aOut << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  uint32_t count = aDriver.getTraceCount();
+  uint64_t timestamp = 0u;    // unwrapped microseconds from the first frame
+  for (uint32_t i = 0u; i < count; ++i) {
+    auto const &record = aDriver.getTraceRecord(i);
+    uint32_t duration = (i + 1u < count ? aDriver.getTraceRecord(i + 1u).mTimestamp - record.mTimestamp : 1u);
+    bool dummy = (record.mFlags & tL9945::cTraceFlagDummy) > 0u;
+    aOut << (i > 0u ? "," : "") << "\n{\"name\":\"" << (dummy ? "dummy " : "command ") << static_cast<uint32_t>(record.mCommand)
+         << "\",\"cat\":\"spi\",\"ph\":\"X\",\"ts\":" << timestamp << ",\"dur\":" << (duration > 0u ? duration : 1u)
+         << ",\"pid\":" << aProcessId << ",\"tid\":" << (dummy ? 2u : 1u) << ",\"args\":{\"tx\":";
+    hex(record.mTx);
+    aOut << ",\"rx\":";
+    hex(record.mRx);
+    aOut << ",\"spiOk\":" << ((record.mFlags & tL9945::cTraceFlagSpiOk) > 0u ? "true" : "false")
+         << ",\"parityOk\":" << ((record.mFlags & tL9945::cTraceFlagParityOk) > 0u ? "true" : "false")
+         << ",\"delayMs\":" << record.mDelay << "}}";
+    timestamp += duration;
+  }
+  aOut << "\n]}\n";
+}
+
+}
+
+#endif